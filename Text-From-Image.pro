@@ -1,4 +1,4 @@
-QT       += core gui
+QT       += core gui concurrent
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
 CONFIG += c++17
@@ -20,7 +20,25 @@ SOURCES = \
     ./src/imagetextobject.cpp \
     ./src/options.cpp \
     ./src/colortray.cpp \
-    ./src/tabscroll.cpp
+    ./src/tabscroll.cpp \
+    ./src/enginepool.cpp \
+    ./src/batch.cpp \
+    ./src/ocrcache.cpp \
+    ./src/layouttree.cpp \
+    ./src/preprocess.cpp \
+    ./src/ocrmonitor.cpp \
+    ./src/ocrscheduler.cpp \
+    ./src/zoompyramid.cpp \
+    ./src/imagebuffer.cpp \
+    ./src/highlightlayer.cpp \
+    ./src/spatialgrid.cpp \
+    ./src/historystore.cpp \
+    ./src/tiledimage.cpp \
+    ./src/colorstats.cpp \
+    ./src/colorindex.cpp \
+    ./src/fillengine.cpp \
+    ./src/fillscheduler.cpp \
+    ./src/timing.cpp
 
 HEADERS = \
     ./headers/mainwindow.h \
@@ -28,11 +46,28 @@ HEADERS = \
     ./headers/imagetextobject.h \
     ./headers/options.h \
     ./headers/colortray.h \
-    ./headers/tabscroll.h
+    ./headers/tabscroll.h \
+    ./headers/enginepool.h \
+    ./headers/batch.h \
+    ./headers/ocrcache.h \
+    ./headers/layouttree.h \
+    ./headers/preprocess.h \
+    ./headers/ocrmonitor.h \
+    ./headers/ocrscheduler.h \
+    ./headers/zoompyramid.h \
+    ./headers/imagebuffer.h \
+    ./headers/highlightlayer.h \
+    ./headers/spatialgrid.h \
+    ./headers/historystore.h \
+    ./headers/tiledimage.h \
+    ./headers/colorstats.h \
+    ./headers/colorindex.h \
+    ./headers/fillengine.h \
+    ./headers/fillscheduler.h \
+    ./headers/timing.h
 
 FORMS = \
     ./forms/mainwindow.ui \
-    ./forms/imagetextobject.ui \
     ./forms/options.ui \
     ./forms/colortray.ui \
     ./forms/tabscroll.ui
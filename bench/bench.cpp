@@ -0,0 +1,111 @@
+﻿#include "bench.h"
+#include "opencv2/imgproc.hpp"
+#include <QElapsedTimer>
+#include <QHash>
+#include <QRegularExpression>
+#include <QStringList>
+#include <QTextStream>
+#include <QVector>
+#include <algorithm>
+
+double measure(const std::function<void()> &task, int runs) {
+  task();
+
+  QVector<qint64> times;
+  for (auto i = 0; i < runs; i++) {
+    QElapsedTimer timer;
+    timer.start();
+    task();
+    times.push_back(timer.nsecsElapsed());
+  }
+  std::sort(times.begin(), times.end());
+  return times[times.size() / 2] / 1e6;
+}
+
+void report(const QString &suite, const QString &label, double ms,
+            const QString &note) {
+  QTextStream out{stdout};
+  out << QString{"%1 %2 %3 ms"}
+             .arg(suite, -12)
+             .arg(label, -36)
+             .arg(ms, 10, 'f', 3);
+  if (!note.isEmpty()) {
+    out << "  " << note;
+  }
+  out << "\n";
+}
+
+cv::Mat syntheticPage(int width, int height, int seed, bool words,
+                      QString *text) {
+  static const char *const vocabulary[] = {
+      "the",  "quick",  "brown",   "fox",    "jumps", "over",
+      "lazy", "dog",    "image",   "text",   "page",  "recognition",
+      "line", "column", "tesseract", "layout", "block", "paragraph"};
+  constexpr const int count = sizeof(vocabulary) / sizeof(vocabulary[0]);
+
+  cv::RNG rng{static_cast<uint64>(seed)};
+  cv::Mat page{height, width, CV_8UC3,
+               cv::Scalar{BENCH_PAPER[0], BENCH_PAPER[1], BENCH_PAPER[2]}};
+  cv::Mat noise{height, width, CV_8UC3};
+  rng.fill(noise, cv::RNG::NORMAL, 0, 4);
+  page += noise;
+  if (!words) {
+    return page;
+  }
+
+  for (auto y = BENCH_LINE_HEIGHT; y < height; y += BENCH_LINE_HEIGHT) {
+    QStringList line;
+    auto x = 20;
+    while (x < width - 200) {
+      const std::string word = vocabulary[rng.uniform(0, count)];
+      line << QString::fromStdString(word);
+      const cv::Scalar ink{rng.uniform(0, 60), rng.uniform(0, 60),
+                           rng.uniform(0, 60)};
+      cv::putText(page, word, cv::Point{x, y}, cv::FONT_HERSHEY_SIMPLEX, 0.9,
+                  ink, 2, cv::LINE_AA);
+      int baseline = 0;
+      x += cv::getTextSize(word, cv::FONT_HERSHEY_SIMPLEX, 0.9, 2, &baseline)
+               .width +
+           18;
+    }
+    if (text) {
+      *text += line.join(' ') + '\n';
+    }
+  }
+  return page;
+}
+
+OcrConfig benchConfig() {
+  return OcrConfig{tesseract::RIL_WORD,
+                   tesseract::OEM_DEFAULT,
+                   tesseract::PSM_AUTO,
+                   "eng",
+                   false,
+                   DEFAULT_TILE_SIZE,
+                   DEFAULT_TILE_OVERLAP,
+                   false,
+                   true,
+                   false,
+                   true,
+                   0,
+                   0,
+                   DEFAULT_PADDING};
+}
+
+double wordRecall(const QString &expected, const QString &recognized) {
+  const QRegularExpression space{"\\s+"};
+  QHash<QString, int> found;
+  for (const auto &word : recognized.split(space, Qt::SkipEmptyParts)) {
+    found[word]++;
+  }
+
+  const auto words = expected.split(space, Qt::SkipEmptyParts);
+  auto hits = 0;
+  for (const auto &word : words) {
+    if (found.value(word) > 0) {
+      found[word]--;
+      hits++;
+    }
+  }
+  return words.isEmpty() ? 1.0 : static_cast<double>(hits) / words.size();
+}
@@ -0,0 +1,37 @@
+﻿#ifndef BENCH_H
+#define BENCH_H
+
+#include "../headers/options.h"
+#include "opencv2/core/mat.hpp"
+#include <QString>
+#include <functional>
+
+constexpr const int BENCH_RUNS = 5;
+constexpr const int BENCH_LINE_HEIGHT = 40;
+
+// Median wall time of runs calls to task in milliseconds, after one call
+// that is not counted
+double measure(const std::function<void()> &task, int runs = BENCH_RUNS);
+void report(const QString &suite, const QString &label, double ms,
+            const QString &note = {});
+
+constexpr const double BENCH_PAPER[] = {235, 240, 245};
+
+// A page of dark words in lines on a light, slightly noisy background. The
+// same seed always draws the same page, without words it is the paper alone.
+// text receives the words drawn, a line of the page per line.
+cv::Mat syntheticPage(int width, int height, int seed = 1, bool words = true,
+                      QString *text = nullptr);
+// The defaults of a fresh settings file, without the cache
+OcrConfig benchConfig();
+// Share of the words of expected found in recognized, in any order
+double wordRecall(const QString &expected, const QString &recognized);
+
+void benchColors();
+void benchFills();
+void benchEngines();
+void benchTiling();
+void benchPreprocessing();
+void benchSelection();
+
+#endif // BENCH_H
@@ -0,0 +1,35 @@
+QT       += core gui concurrent widgets
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = tfi-bench
+
+unix{
+CONFIG += link_pkgconfig
+
+PKGCONFIG +=  opencv4
+PKGCONFIG +=  tesseract
+}
+
+# the app's own units without its main(), so the suites time the shipped code
+SOURCES = $$files(../src/*.cpp)
+SOURCES -= ../src/main.cpp
+SOURCES += \
+    ./main.cpp \
+    ./bench.cpp \
+    ./colors.cpp \
+    ./fills.cpp \
+    ./engines.cpp \
+    ./tiling.cpp \
+    ./preprocessing.cpp \
+    ./selection.cpp
+
+HEADERS = $$files(../headers/*.h)
+HEADERS += \
+    ./bench.h
+
+FORMS = $$files(../forms/*.ui)
+
+RESOURCES += \
+    ../res/res.qrc
@@ -0,0 +1,81 @@
+﻿#include "../headers/colorstats.h"
+#include "bench.h"
+#include <algorithm>
+#include <cstdint>
+
+// The counting analyseColors() replaced: every pixel of the box packed, the
+// pixels outside the text mask as 0, and the keys sorted into runs.
+static QVector<uint32_t> sortedPalette(const cv::Mat &roi) {
+  const cv::Mat mask = textMask(roi);
+  std::vector<uint32_t> keys;
+  keys.reserve(roi.total());
+  for (auto y = 0; y < roi.rows; y++) {
+    const uchar *pixel = roi.ptr(y);
+    for (auto x = 0; x < roi.cols; x++, pixel += 3) {
+      keys.push_back(mask.at<uchar>(y, x)
+                         ? pixel[0] | (pixel[1] << 8) | (pixel[2] << 16)
+                         : 0);
+    }
+  }
+  std::sort(keys.begin(), keys.end());
+
+  QVector<QPair<int, uint32_t>> runs;
+  for (size_t i = 0; i < keys.size();) {
+    size_t j = i + 1;
+    while (j < keys.size() && keys[j] == keys[i]) {
+      j++;
+    }
+    if (keys[i]) {
+      runs.push_back({static_cast<int>(j - i), keys[i]});
+    }
+    i = j;
+  }
+  std::stable_sort(runs.begin(), runs.end(),
+                   [](const QPair<int, uint32_t> &lhs,
+                      const QPair<int, uint32_t> &rhs) {
+                     return lhs.first > rhs.first;
+                   });
+
+  QVector<uint32_t> colors;
+  for (auto i = 0; i < qMin(PALETTE_LIMIT, runs.size()); i++) {
+    colors.push_back(runs[i].second);
+  }
+  return colors;
+}
+
+// the most frequent text color of both, ties aside they agree on the rest
+static bool sameLead(const ColorStats &stats, const QVector<uint32_t> &keys) {
+  if (keys.isEmpty()) {
+    return stats.palette.first() == cv::Scalar{0, 0, 0};
+  }
+  const uint32_t key = keys.first();
+  return stats.palette.first() ==
+         cv::Scalar(key & 0xff, (key >> 8) & 0xff, (key >> 16) & 0xff);
+}
+
+// One box at a time, the way boxes are analysed before their page has a
+// ColorIndex, from a single word up to a full-width band.
+void benchColors() {
+  const cv::Mat page = syntheticPage(2480, 3508);
+  const QVector<cv::Size> sizes{{48, 32}, {160, 40}, {640, 80}, {2400, 400}};
+
+  for (const auto &size : sizes) {
+    const cv::Rect box{cv::Point{20, BENCH_LINE_HEIGHT - 28}, size};
+    const QString label = QString{"%1x%2 box"}.arg(size.width).arg(size.height);
+
+    ColorStats fused;
+    const double single =
+        measure([&] { fused = analyseColors(page, box); }, 20);
+    QVector<uint32_t> sorted;
+    const double baseline = measure(
+        [&] {
+          borderColor(page, box);
+          sorted = sortedPalette(page(box));
+        },
+        20);
+
+    report("colors", label + " one pass", single,
+           sameLead(fused, sorted) ? "same top color" : "top color differs");
+    report("colors", label + " sorted keys", baseline);
+  }
+}
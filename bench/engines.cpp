@@ -0,0 +1,31 @@
+﻿#include "../headers/enginepool.h"
+#include "../headers/imageframe.h"
+#include "bench.h"
+
+// A small extraction, where loading the model used to dominate. Cold drops
+// the pool's idle engines before every run, the way each extraction paid
+// for its own Init() before engines were pooled. Warm leases the engine the
+// previous run released.
+void benchEngines() {
+  QString expected;
+  const cv::Mat page = syntheticPage(640, 3 * BENCH_LINE_HEIGHT + 20, 1, true,
+                                     &expected);
+  const TiledImage image{page};
+  const OcrConfig config = benchConfig();
+
+  QString text;
+  const double cold = measure([&] {
+    EnginePool::instance().rebuild();
+    LayoutTree layout;
+    text = ImageFrame::collect(image, config, layout);
+  });
+  report("engines", "small page, cold engine", cold,
+         QString{"recall %1"}.arg(wordRecall(expected, text), 0, 'f', 2));
+
+  const double warm = measure([&] {
+    LayoutTree layout;
+    text = ImageFrame::collect(image, config, layout);
+  });
+  report("engines", "small page, pooled engine", warm,
+         QString{"init share %1%"}.arg(100 * (cold - warm) / cold, 0, 'f', 0));
+}
@@ -0,0 +1,88 @@
+﻿#include "../headers/fillengine.h"
+#include "../headers/fillscheduler.h"
+#include "bench.h"
+#include "opencv2/imgproc.hpp"
+
+typedef struct FillFixture {
+  QString name;
+  cv::Rect box;
+  int grow; // pixels the hole reaches past the ink, wider holes are harder
+} FillFixture;
+
+// Every tier on the same holes cut out of a synthetic page. The error is the
+// mean absolute difference from the paper under the hole, lower is better.
+void benchFills() {
+  const int width = 1240, height = 1754;
+  const cv::Mat page = syntheticPage(width, height);
+  const cv::Mat paper = syntheticPage(width, height, 1, false);
+  const cv::Scalar background{BENCH_PAPER[0], BENCH_PAPER[1], BENCH_PAPER[2]};
+
+  cv::Mat ink;
+  cv::absdiff(page, paper, ink);
+  cv::cvtColor(ink, ink, cv::COLOR_BGR2GRAY);
+  cv::threshold(ink, ink, 24, 255, cv::THRESH_BINARY);
+
+  const QVector<FillFixture> fixtures{
+      {"word", cv::Rect{20, 12, 160, 40}, 1},
+      {"line", cv::Rect{20, 12, 1000, 40}, 1},
+      {"block", cv::Rect{20, 12, 1000, 400}, 1},
+      {"bold word", cv::Rect{20, 12, 160, 40}, 6},
+  };
+  const QVector<Options::fillMethod> methods{
+      Options::NEIGHBOR, Options::TELEA, Options::INPAINT,
+      Options::MULTISCALE};
+
+  for (const auto &fixture : fixtures) {
+    cv::Mat mask;
+    cv::dilate(ink(fixture.box), mask,
+               cv::getStructuringElement(
+                   cv::MORPH_ELLIPSE,
+                   cv::Size{2 * fixture.grow + 1, 2 * fixture.grow + 1}));
+    const cv::Mat source = page(fixture.box);
+    const cv::Mat truth = paper(fixture.box);
+
+    for (const auto method : methods) {
+      cv::Mat filled;
+      const double ms = measure([&] {
+        filled = fillRegion(source, mask, method, background);
+      });
+
+      cv::Mat error;
+      cv::absdiff(filled, truth, error);
+      const cv::Scalar mean = cv::mean(error, mask);
+      const double mae = (mean[0] + mean[1] + mean[2]) / 3;
+      report("fills", fixture.name + " " + fillName(method), ms,
+             QString{"error %1"}.arg(mae, 0, 'f', 2));
+    }
+  }
+
+  // erasing every word of the page at once, through fillHoles() and one
+  // fillRegion() per word
+  QVector<FillHole> holes;
+  for (auto y = 12; y + 40 <= height; y += BENCH_LINE_HEIGHT) {
+    for (auto x = 20; x + 160 <= width; x += 160) {
+      const cv::Rect region{x, y, 160, 40};
+      holes.push_back(FillHole{region, ink(region).clone()});
+    }
+  }
+  for (const auto method : methods) {
+    const double batched = measure(
+        [&] {
+          cv::Mat image = page.clone();
+          fillHoles(image, holes, method);
+        },
+        1);
+    const double single = measure(
+        [&] {
+          cv::Mat image = page.clone();
+          for (const auto &hole : holes) {
+            fillRegion(image(hole.region), hole.mask, method, background)
+                .copyTo(image(hole.region), hole.mask);
+          }
+        },
+        1);
+    const QString label = QString{"%1 words "}.arg(holes.size());
+    report("fills", label + fillName(method) + " batched", batched);
+    report("fills", label + fillName(method) + " one by one", single);
+  }
+}
@@ -0,0 +1,38 @@
+﻿#include "bench.h"
+#include <QApplication>
+#include <QMap>
+#include <QTextStream>
+
+// Runs the named suites, or all of them, and prints one line per case.
+// Nothing is shown on screen, the app's widgets only exist off screen.
+int main(int argc, char *argv[]) {
+  if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+  }
+  QApplication a(argc, argv);
+
+  const QMap<QString, std::function<void()>> suites{
+      {"colors", benchColors},
+      {"fills", benchFills},
+      {"engines", benchEngines},
+      {"tiling", benchTiling},
+      {"preprocess", benchPreprocessing},
+      {"selection", benchSelection},
+  };
+
+  auto names = a.arguments().mid(1);
+  if (names.isEmpty()) {
+    names = suites.keys();
+  }
+  for (const auto &name : names) {
+    if (!suites.contains(name)) {
+      QTextStream{stderr} << "unknown suite " << name << ", have "
+                          << suites.keys().join(", ") << "\n";
+      return 1;
+    }
+  }
+  for (const auto &name : names) {
+    suites[name]();
+  }
+  return 0;
+}
@@ -0,0 +1,50 @@
+﻿#include "../headers/imageframe.h"
+#include "../headers/preprocess.h"
+#include "bench.h"
+#include "opencv2/imgproc.hpp"
+
+typedef struct Variant {
+  QString name;
+  std::function<void(OcrConfig &)> apply;
+} Variant;
+
+// Extraction with every stage, without each one in turn, and with none, on
+// a page at its drawn size and at half of it, where the glyphs fall below
+// what Tesseract reads well. The note holds the stages' own time.
+void benchPreprocessing() {
+  QString expected;
+  const cv::Mat full = syntheticPage(1240, 600, 3, true, &expected);
+  cv::Mat half;
+  cv::resize(full, half, cv::Size{}, 0.5, 0.5, cv::INTER_AREA);
+
+  const QVector<Variant> variants{
+      {"all stages", [](OcrConfig &) {}},
+      {"with binarize", [](OcrConfig &c) { c.binarize = true; }},
+      {"without normalize", [](OcrConfig &c) { c.normalize = false; }},
+      {"without padding", [](OcrConfig &c) { c.padding = 0; }},
+      {"no preprocessing", [](OcrConfig &c) { c.preprocess = false; }},
+  };
+
+  for (const auto &page : {full, half}) {
+    const TiledImage image{page};
+    const QString size = QString{"%1x%2"}.arg(page.cols).arg(page.rows);
+    for (const auto &variant : variants) {
+      OcrConfig config = benchConfig();
+      variant.apply(config);
+
+      QString text;
+      const double ms = measure(
+          [&] {
+            LayoutTree layout;
+            text = ImageFrame::collect(image, config, layout);
+          },
+          1);
+      const double stages =
+          config.preprocess ? measure([&] { preprocess(page, config); }) : 0;
+      report("preprocess", size + " " + variant.name, ms,
+             QString{"recall %1, stages %2 ms"}
+                 .arg(wordRecall(expected, text), 0, 'f', 2)
+                 .arg(stages, 0, 'f', 1));
+    }
+  }
+}
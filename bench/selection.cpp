@@ -0,0 +1,60 @@
+﻿#include "../headers/highlightlayer.h"
+#include "bench.h"
+
+constexpr const int BENCH_BOX_WIDTH = 60;
+constexpr const int BENCH_BOX_HEIGHT = 20;
+
+// Word sized boxes laid out like lines of text on a page tall enough to
+// hold count of them
+static QVector<ImageTextObject *> wordBoxes(int count, QSize &page) {
+  constexpr const int perLine = 30;
+  QVector<ImageTextObject *> boxes;
+  for (auto i = 0; i < count; i++) {
+    auto obj = new ImageTextObject{};
+    obj->topLeft = QPoint{20 + (i % perLine) * (BENCH_BOX_WIDTH + 10),
+                          20 + (i / perLine) * (BENCH_BOX_HEIGHT + 10)};
+    obj->bottomRight =
+        obj->topLeft + QPoint{BENCH_BOX_WIDTH, BENCH_BOX_HEIGHT};
+    boxes.push_back(obj);
+  }
+  page = QSize{40 + perLine * (BENCH_BOX_WIDTH + 10),
+               40 + (count / perLine + 1) * (BENCH_BOX_HEIGHT + 10)};
+  return boxes;
+}
+
+// A rubber band over a paragraph near the middle of the page, answered by
+// the grid as inliers() does and by testing every box as before the grid.
+// The time covers the query and highlighting what it found.
+void benchSelection() {
+  for (const auto count : {1000, 10000, 100000}) {
+    QSize page;
+    const auto boxes = wordBoxes(count, page);
+    HighlightLayer layer;
+    layer.setBounds(page);
+    layer.setObjects(&boxes);
+
+    const QRect band{page.width() / 4, page.height() / 2, page.width() / 2,
+                     10 * (BENCH_BOX_HEIGHT + 10)};
+    int found = 0;
+    const double grid = measure([&] {
+      const auto hits = layer.objectsIn(band);
+      for (const auto &obj : hits) {
+        obj->selectHighlight();
+      }
+      found = hits.size();
+    });
+    const double scan = measure([&] {
+      for (const auto &obj : boxes) {
+        if (band.intersects(QRect{obj->topLeft, obj->bottomRight})) {
+          obj->selectHighlight();
+        }
+      }
+    });
+
+    const QString label = QString{"%1 boxes"}.arg(count);
+    report("selection", label + " grid", grid,
+           QString{"%1 selected"}.arg(found));
+    report("selection", label + " linear scan", scan);
+    qDeleteAll(boxes);
+  }
+}
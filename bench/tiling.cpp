@@ -0,0 +1,57 @@
+﻿#include "../headers/enginepool.h"
+#include "../headers/imageframe.h"
+#include "../headers/ocrscheduler.h"
+#include "bench.h"
+#include <QThread>
+
+constexpr const int BENCH_TILE_SIZE = 512;
+constexpr const int BENCH_TILE_OVERLAP = 64;
+
+// A tall page recognized whole, then in bands with the scheduler limited to
+// 1, 2, 4... workers up to the core count. Recall shows whether the bands
+// lose or duplicate words at their seams.
+void benchTiling() {
+  QString expected;
+  const cv::Mat page = syntheticPage(1240, 3508, 2, true, &expected);
+  const TiledImage image{page};
+  OcrConfig config = benchConfig();
+  const int cores = QThread::idealThreadCount();
+  EnginePool::instance().setIdleLimit(cores);
+
+  // submitted like the app's extractions, so the calling job takes one of
+  // the scheduler's workers and the bands borrow the rest
+  QString text;
+  const auto run = [&] {
+    OcrScheduler::instance()
+        .submit(nullptr, 0,
+                [&] {
+                  LayoutTree layout;
+                  text = ImageFrame::collect(image, config, layout);
+                })
+        .waitForFinished();
+  };
+
+  const double whole = measure(run, 1);
+  report("tiling", "whole page", whole,
+         QString{"recall %1"}.arg(wordRecall(expected, text), 0, 'f', 2));
+
+  config.tiled = true;
+  config.tileSize = BENCH_TILE_SIZE;
+  config.tileOverlap = BENCH_TILE_OVERLAP;
+  double single = 0;
+  for (auto jobs = 1;; jobs = qMin(2 * jobs, cores)) {
+    OcrScheduler::instance().setMaxJobs(jobs);
+    const double ms = measure(run, 1);
+    if (jobs == 1) {
+      single = ms;
+    }
+    report("tiling", QString{"bands on %1 workers"}.arg(jobs), ms,
+           QString{"speed up %1x, recall %2"}
+               .arg(single / ms, 0, 'f', 2)
+               .arg(wordRecall(expected, text), 0, 'f', 2));
+    if (jobs == cores) {
+      break;
+    }
+  }
+  OcrScheduler::instance().setMaxJobs(0);
+}
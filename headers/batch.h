@@ -0,0 +1,40 @@
+﻿#ifndef BATCH_H
+#define BATCH_H
+
+#include "../headers/imageframe.h"
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// Headless extraction for `tfi --batch`. No widgets are created; every image
+// goes through ImageFrame::collect() so results match the GUI.
+class Batch {
+public:
+  explicit Batch(QVector<QString> args);
+  int run();
+
+private:
+  typedef struct Result {
+    QString file;
+    bool ok;
+    QString error;
+    qint64 loadMs, recognizeMs, writeMs;
+    int boxes;
+  } Result;
+
+  bool valid, useCache;
+  int jobs;
+  QString outputDir;
+  QStringList inputs;
+  QHash<QString, QString> outputNames;
+
+  bool parse(QVector<QString> args);
+  QStringList expand(const QString &pattern) const;
+  void assignOutputNames();
+  Result process(const QString &file, const OcrConfig &config) const;
+  int summarize(const QVector<Result> &results, qint64 wallMs) const;
+  static void usage();
+};
+
+#endif // BATCH_H
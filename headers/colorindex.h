@@ -0,0 +1,39 @@
+﻿#ifndef COLORINDEX_H
+#define COLORINDEX_H
+
+#include "../headers/colorstats.h"
+#include "../headers/tiledimage.h"
+#include "opencv2/core/mat.hpp"
+#include <QVector>
+#include <functional>
+#include <vector>
+
+constexpr const int QUANTIZE_COLORS = 32;
+constexpr const int QUANTIZE_SAMPLES = 16384;
+constexpr const int QUANTIZE_ITERATIONS = 10;
+constexpr const int QUANTIZE_BITS = 5;
+
+// The colors of a whole image reduced once to QUANTIZE_COLORS by k-means on
+// a sample of its pixels, with a lookup table from 5 bit per channel color to
+// the nearest of them and a label for every pixel. Boxes take their colors
+// from label counts over the box, a byte per pixel and no sorting. Until it
+// is built, boxes are counted exactly with analyseColors().
+class ColorIndex {
+public:
+  explicit ColorIndex(const TiledImage &image,
+                      const std::function<bool()> &cancelled = {});
+
+  void update(const cv::Mat &image, const cv::Rect &region);
+  ColorStats analyse(const cv::Rect &box) const;
+  cv::Size size() const;
+
+private:
+  QVector<cv::Scalar> colors;
+  std::vector<uchar> lookup;
+  cv::Mat labels;
+
+  void label(const cv::Mat &image, cv::Mat out) const;
+  int borderLabel(const cv::Rect &box) const;
+};
+
+#endif // COLORINDEX_H
@@ -0,0 +1,26 @@
+﻿#ifndef COLORSTATS_H
+#define COLORSTATS_H
+
+#include "opencv2/core/mat.hpp"
+#include <QVector>
+#include <vector>
+
+constexpr const int PALETTE_LIMIT = 10;
+constexpr const double INVERT_MASK_THRESH = 0.75;
+
+typedef struct ColorStats {
+  cv::Scalar background;
+  QVector<cv::Scalar> palette;
+} ColorStats;
+
+// Background color and font palette of the text inside box, counted exactly.
+// One pass over the box fills a gray histogram and a table of packed 24 bit
+// colors. Otsu's threshold then comes from the histogram, and as a color has
+// a single gray level the text colors are picked from the table without
+// revisiting the pixels. Used for a box needed before its page has a
+// ColorIndex.
+ColorStats analyseColors(const cv::Mat &image, const cv::Rect &box);
+cv::Mat textMask(const cv::Mat &roi);
+cv::Scalar borderColor(const cv::Mat &image, const cv::Rect &box);
+
+#endif // COLORSTATS_H
@@ -0,0 +1,61 @@
+﻿#ifndef ENGINEPOOL_H
+#define ENGINEPOOL_H
+
+#include "tesseract/baseapi.h"
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QPair>
+#include <QString>
+#include <QVector>
+#include <tesseract/publictypes.h>
+
+constexpr const int POOL_IDLE_LIMIT = 8;
+constexpr const char *const BUNDLED_MODEL = ":/other/eng.traineddata";
+
+// Process-wide pool of initialized engines keyed by (data file, OEM). Loading
+// the traineddata model dominates small extractions, so engines are kept warm
+// and only have their per-image state cleared between jobs.
+// Models are initialized from a read-only memory map of the traineddata file,
+// or from the compiled-in resource for the bundled eng model, so nothing is
+// extracted to disk and the file is read at most once per process.
+class EnginePool {
+public:
+  typedef QPair<QString, int> Key;
+  typedef struct Model {
+    const uchar *data;
+    qint64 size;
+  } Model;
+
+  static EnginePool &instance();
+  ~EnginePool();
+
+  tesseract::TessBaseAPI *acquire(const QString &dataFile,
+                                  tesseract::OcrEngineMode OEM);
+  void release(tesseract::TessBaseAPI *api);
+  void warm(const QString &dataFile, tesseract::OcrEngineMode OEM);
+  void rebuild();
+  void setIdleLimit(int limit);
+  bool hasModel(const QString &dataFile);
+
+private:
+  EnginePool() = default;
+  EnginePool(const EnginePool &) = delete;
+  EnginePool &operator=(const EnginePool &) = delete;
+
+  QMutex mutex;
+  int generation{0};
+  int idleLimit{POOL_IDLE_LIMIT};
+  QHash<Key, QVector<tesseract::TessBaseAPI *>> idle;
+  QHash<tesseract::TessBaseAPI *, QPair<Key, int>> leased;
+  QHash<QString, Model> models;
+  QVector<QFile *> mapped;
+  QVector<QByteArray> buffers;
+
+  Model model(const QString &dataFile);
+  tesseract::TessBaseAPI *create(const Key &key);
+  static void destroy(tesseract::TessBaseAPI *api);
+};
+
+#endif // ENGINEPOOL_H
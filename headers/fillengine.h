@@ -0,0 +1,29 @@
+﻿#ifndef FILLENGINE_H
+#define FILLENGINE_H
+
+#include "../headers/options.h"
+#include "opencv2/core/mat.hpp"
+#include <QString>
+
+constexpr const int FILL_RADIUS = 3;
+constexpr const int FILL_SYNC_AREA = 128 * 128;
+constexpr const int MULTISCALE_LEVELS = 3;
+constexpr const int MULTISCALE_MIN_SIZE = 16;
+
+// A region shown with the quick fill while the chosen one is worked out in
+// the background. fast is what was written, the refined pixels only replace
+// those that still hold it.
+typedef struct FillRequest {
+  cv::Rect region;
+  cv::Mat source, mask, fast;
+  Options::fillMethod method;
+} FillRequest;
+
+// Fills the set pixels of mask in source. From fastest to best: the flat
+// background color, Telea, Navier-Stokes, and Navier-Stokes blended with a
+// coarse pass for holes wider than the radius.
+cv::Mat fillRegion(const cv::Mat &source, const cv::Mat &mask,
+                   Options::fillMethod method, const cv::Scalar &background);
+QString fillName(Options::fillMethod method);
+
+#endif // FILLENGINE_H
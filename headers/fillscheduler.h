@@ -0,0 +1,27 @@
+﻿#ifndef FILLSCHEDULER_H
+#define FILLSCHEDULER_H
+
+#include "../headers/fillengine.h"
+#include "opencv2/core/mat.hpp"
+#include <QVector>
+
+constexpr const int FILL_TILE_SIZE = 384;
+constexpr const int FILL_TILE_OVERLAP = 16;
+constexpr const int FILL_BATCH_AREA = 96 * 96;
+constexpr const int FILL_ATLAS_WIDTH = 1024;
+constexpr const int FILL_ATLAS_AREA = 512 * 512;
+
+// the set pixels of mask are to be filled, region is where mask sits
+typedef struct FillHole {
+  cv::Rect region;
+  cv::Mat mask;
+} FillHole;
+
+// Inpaints every hole in image at once. Holes close enough to see each other
+// are filled together, large ones are cut into overlapping tiles that are
+// blended back across the seams, and small ones are packed into shared
+// passes. The passes run on the worker threads.
+void fillHoles(cv::Mat &image, const QVector<FillHole> &holes,
+               Options::fillMethod method);
+
+#endif // FILLSCHEDULER_H
@@ -0,0 +1,37 @@
+﻿#ifndef HIGHLIGHTLAYER_H
+#define HIGHLIGHTLAYER_H
+
+#include "../headers/imagetextobject.h"
+#include "../headers/spatialgrid.h"
+#include <QGraphicsItem>
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+#include <QVector>
+
+// Paints the highlights of every text object of a tab as one scene item
+// above the image tiles. It works in image coordinates and is scaled with the
+// zoom, so zooming or restyling any number of boxes is a single repaint.
+// Painting, picking and rubber band queries go through a grid over the boxes,
+// which must be reindexed whenever objects are added, removed or reordered.
+class HighlightLayer : public QGraphicsItem {
+public:
+  HighlightLayer();
+
+  void setObjects(const QVector<ImageTextObject *> *objects);
+  void reindex();
+  void moved(ImageTextObject *obj, const QRect &from);
+  void setBounds(const QSize &size);
+  ImageTextObject *objectAt(const QPoint &point) const;
+  QVector<ImageTextObject *> objectsIn(const QRect &box) const;
+
+  QRectF boundingRect() const override;
+  void paint(QPainter *painter, const QStyleOptionGraphicsItem *option,
+             QWidget *widget) override;
+
+private:
+  const QVector<ImageTextObject *> *objects;
+  SpatialGrid grid;
+  QRectF bounds;
+};
+
+#endif // HIGHLIGHTLAYER_H
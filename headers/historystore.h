@@ -0,0 +1,63 @@
+﻿#ifndef HISTORYSTORE_H
+#define HISTORYSTORE_H
+
+#include "opencv2/core/mat.hpp"
+#include <QByteArray>
+#include <QFuture>
+#include <QTemporaryFile>
+#include <QVector>
+#include <atomic>
+#include <functional>
+
+constexpr const int DEFAULT_HISTORY_TAB_MB = 256;
+constexpr const int DEFAULT_HISTORY_MB = 1024;
+constexpr const int HISTORY_RAW_STEPS = 2;
+constexpr const int HISTORY_COMPRESSION = 1;
+
+// Pixels an edit overwrote. Held raw while close to the current state, then
+// compressed in memory, then written out to the tab's spill file. A whole
+// frame patch holds the image a paste replaced, whatever its size.
+typedef struct Patch {
+  cv::Rect region;
+  cv::Mat pixels;
+  QByteArray packed;
+  int type{0};
+  qint64 offset{-1}, length{0};
+  bool wholeFrame{false};
+} Patch;
+
+// Keeps the undo history of one tab within its memory budget and its share of
+// the process-wide one. compact() works on a background thread, so the
+// patches handed to it must not be touched until wait() or load().
+class HistoryStore {
+public:
+  HistoryStore();
+  ~HistoryStore();
+
+  static void setBudget(int tabMegabytes, int totalMegabytes);
+  static qint64 totalBytes();
+
+  // entries ordered from the furthest step to the nearest
+  void compact(const QVector<QVector<Patch> *> &entries,
+               const std::function<void()> &done);
+  void load(QVector<Patch> &patches);
+  void release(QVector<Patch> &patches);
+  void wait();
+
+  qint64 bytes() const;
+  qint64 spilledBytes() const;
+
+private:
+  QFuture<void> pending;
+  QTemporaryFile file;
+  std::atomic<qint64> held{0}, spilled{0};
+
+  static std::atomic<qint64> total, tabBudget, totalBudget;
+
+  static qint64 size(const Patch &patch);
+  static void pack(Patch &patch);
+  static void unpack(Patch &patch);
+  bool spill(Patch &patch);
+};
+
+#endif // HISTORYSTORE_H
@@ -0,0 +1,36 @@
+﻿#ifndef IMAGEBUFFER_H
+#define IMAGEBUFFER_H
+
+#include "../headers/colorindex.h"
+#include "opencv2/core/mat.hpp"
+#include <QAtomicInt>
+#include <QImage>
+#include <QSharedPointer>
+
+// BGR pixels shared by reference between OpenCV, Qt and the undo history.
+// Assigning one buffer to another shares the pixels. Every full frame copy
+// made here is counted so edits can report what they cost. The quantized
+// colors of the pixels are kept with them and dropped when a new image is
+// assigned.
+class ImageBuffer : public cv::Mat {
+public:
+  ImageBuffer() = default;
+  ImageBuffer(const cv::Mat &matrix);
+
+  static ImageBuffer fromImage(const QImage &image);
+  static int copies();
+
+  QImage view();
+
+  const ColorIndex *colors() const;
+  bool hasColors() const;
+  void setColors(const QSharedPointer<ColorIndex> &colors);
+  void recolor(const cv::Rect &region);
+
+private:
+  static QAtomicInt copied;
+
+  QSharedPointer<ColorIndex> index;
+};
+
+#endif // IMAGEBUFFER_H
@@ -1,7 +1,14 @@
 ﻿#ifndef IMAGEFRAME_H
 #define IMAGEFRAME_H
 
+#include "../headers/highlightlayer.h"
+#include "../headers/historystore.h"
+#include "../headers/imagebuffer.h"
 #include "../headers/imagetextobject.h"
+#include "../headers/layouttree.h"
+#include "../headers/ocrmonitor.h"
+#include "../headers/tiledimage.h"
+#include "../headers/zoompyramid.h"
 #include "opencv2/imgproc.hpp"
 #include "qhash.h"
 #include "qnamespace.h"
@@ -9,7 +16,10 @@
 #include "ui_mainwindow.h"
 
 #include <QDrag>
+#include <QElapsedTimer>
 #include <QFuture>
+#include <QFutureWatcher>
+#include <QGraphicsPixmapItem>
 #include <QGraphicsScene>
 #include <QGraphicsTextItem>
 #include <QGraphicsView>
@@ -21,12 +31,17 @@
 #include <QPoint>
 #include <QRubberBand>
 #include <QScrollBar>
+#include <QSharedPointer>
 #include <QStack>
 #include <QVector>
 #include <QWidget>
 #include <QtConcurrent/QtConcurrent>
+#include <atomic>
+#include <climits>
 
 constexpr const double ZOOM_MAX = 5.0;
+constexpr const int VIEW_TILE_SIZE = 512;
+constexpr const int VIEW_PREFETCH = 256;
 
 class ObjectListView : public QListWidget {
   Q_OBJECT
@@ -39,6 +54,8 @@ public:
     setDragDropMode(widget->dragDropMode());
     setSelectionMode(widget->selectionMode());
     setSelectionBehavior(widget->selectionBehavior());
+    // rows are laid out on demand instead of measured one by one
+    setUniformItemSizes(true);
     delete widget;
   };
 
@@ -54,8 +71,9 @@ class ImageFrame : public QGraphicsView {
 public:
   typedef struct State {
     QVector<ImageTextObject *> textObjects;
-    cv::Mat matrix;
     ImageTextObject *selection;
+    // pixels that differ from the neighbouring state, in the order saved
+    QVector<Patch> patches;
     ~State() { delete selection; }
   } State;
 
@@ -77,9 +95,11 @@ public:
   void setImage(QString);
   void setWidgets();
   void extract(cv::Mat *mat = nullptr);
+  void cancel();
   void clear();
   void pasteImage(QImage *img);
   void deleteSelection();
+  void eraseSelections();
   cv::Mat getImageMatrix();
 
   State *&getState();
@@ -88,6 +108,11 @@ public:
   void hideHighlights();
   void renderListView();
 
+  void setGranularity(tesseract::PageIteratorLevel RIL);
+
+  static QString collect(const TiledImage &image, const OcrConfig &config,
+                         LayoutTree &layout, OcrMonitor *monitor = nullptr);
+
 public slots:
   void zoomIn();
   void zoomOut();
@@ -98,9 +123,9 @@ public slots:
 private slots:
   void changeZoom();
   void changeText();
+  void renderViewport();
 
 signals:
-  void processing();
   void colorSelected(cv::Scalar);
   void unlockState();
 
@@ -111,7 +136,6 @@ private:
   QPoint origin;
   QGraphicsScene *scene;
   QWidget *parent;
-  cv::Mat display;
   Options *options;
   Ui::MainWindow *ui;
   QMovie *spinner;
@@ -119,10 +143,28 @@ private:
   QHash<QListWidgetItem *, ImageTextObject *> objectFromItemsMap;
   bool dropper;
   bool middleDown;
-  bool zoomChanged;
 
   QStack<State *> undo, redo;
   State *state;
+  ImageBuffer matrix;
+  QSharedPointer<TiledImage> reading; // what the running recognition sees
+  QSharedPointer<TiledImage> sampling; // what the color prefetch sees
+  LayoutTree layout;
+  ZoomPyramid pyramid;
+  QHash<QPair<int, int>, QGraphicsPixmapItem *> tiles;
+  QSharedPointer<OcrMonitor> monitor;
+  QFuture<void> job;
+  int generation;
+  int copyMark; // ImageBuffer::copies() when the current edit began
+  QFuture<void> colorJob;
+  QFutureWatcher<void> colorWatcher;
+  std::atomic<int> colorGeneration;
+  bool colorQueued; // prefetchColors() was called while colorJob ran
+  QVector<QFuture<void>> fillJobs;
+  int fillGeneration; // bumped when the pixels under a pending fill go back
+  HighlightLayer *overlay;
+  ImageTextObject *pressed; // highlight under the held mouse button
+  HistoryStore history;
 
   void mousePressEvent(QMouseEvent *event) override;
   void mouseReleaseEvent(QMouseEvent *event) override;
@@ -136,12 +178,34 @@ private:
   void initUi(QWidget *parent);
   void showAll();
   void setOptions(Options *options);
-  void populateTextObjects();
+  void populateTextObjects(int from = 0);
   void findSubstrings();
-  void changeImage(QImage *img = nullptr);
-  QString collect(const cv::Mat &matrix);
+  void changeImage();
+  void refreshRegion(const cv::Rect &region);
+  void preserveSnapshots(const cv::Rect &region);
+  void savePixels(State *target, const cv::Rect &region);
+  cv::Rect swapPixels(State *target);
+  void compactHistory();
+  void dropRedo();
+  void showHistory();
+  void showQueue();
+  void prefetchColors();
+  void refineFill(ImageTextObject *obj);
+  void applyFill(const FillRequest &request, const cv::Mat &refined);
   void inliers(QPair<QPoint, QPoint>);
-  void connectSelection(ImageTextObject *obj);
+
+  void addTextObjects(const QVector<OcrBox> &boxes);
+  void streamTextObjects(const QVector<OcrBox> &boxes);
+  void showProgress(int percent);
+  void finishExtraction(const QString &text, const LayoutTree &result,
+                        tesseract::PageIteratorLevel RIL);
+  void stopSpinner();
+
+  static QString recognize(const TiledImage &image, const OcrConfig &config,
+                           LayoutTree &layout, OcrMonitor *monitor);
+  void activate(ImageTextObject *obj);
+  void dragSelection(const QPoint &pos);
+  void releaseObject(ImageTextObject *obj, const QPoint &pos);
 };
 
 #endif // IMAGEFRAME_H
@@ -1,6 +1,9 @@
 ﻿#ifndef IMAGETEXTOBJECT_H
 #define IMAGETEXTOBJECT_H
 
+#include "../headers/colorstats.h"
+#include "../headers/fillscheduler.h"
+#include "../headers/imagebuffer.h"
 #include "../headers/options.h"
 #include "opencv2/core/mat.hpp"
 #include "opencv2/core/types.hpp"
@@ -14,7 +17,8 @@
 #include <QList>
 #include <QMouseEvent>
 #include <QPair>
-#include <QPushButton>
+#include <QRect>
+#include <QRgb>
 #include <QTextEdit>
 #include <QVector>
 #include <QWidget>
@@ -23,112 +27,91 @@
 #include <optional>
 #include <queue>
 
-constexpr const char BLUE_HIGHLIGHT[] = "background:  rgba(37,122,253,100);";
-constexpr const char YELLOW_HIGHLIGHT[] =
-    "background:  rgba(255, 243, 0, 100);";
-constexpr const char PURPLE_HIGHLIGHT[] =
-    "background:  rgba(255, 0, 243, 100);";
-constexpr const char GREEN_HIGHLIGHT[] = "background:  rgba(0, 255, 0, 100);";
-constexpr const int PALETTE_LIMIT = 10;
-constexpr const double INVERT_MASK_THRESH = 0.75;
+constexpr const QRgb BLUE_HIGHLIGHT = qRgba(37, 122, 253, 100);
+constexpr const QRgb YELLOW_HIGHLIGHT = qRgba(255, 243, 0, 100);
+constexpr const QRgb PURPLE_HIGHLIGHT = qRgba(255, 0, 243, 100);
+constexpr const QRgb GREEN_HIGHLIGHT = qRgba(0, 255, 0, 100);
 
-class QcvScalar : public cv::Scalar {
-  friend inline bool operator==(const QcvScalar &e1,
-                                const QcvScalar &e2) noexcept {
-    bool ret = (e1.val[0] == e2.val[0]);
-    ret &= (e1.val[1] == e2.val[1]);
-    ret &= (e1.val[2] == e2.val[2]);
-    return ret;
-  }
-
-  friend inline uint qHash(const QcvScalar &key, uint seed) noexcept {
-    QtPrivate::QHashCombine hash;
-    seed = hash(seed, key.val[0]);
-    seed = hash(seed, key.val[1]);
-    seed = hash(seed, key.val[2]);
-    return seed;
-  }
-};
-
-class Highlight : public QPushButton {
-  Q_OBJECT
-signals:
-  void drag(const QPoint &) const;
-
-public:
-  Highlight(QWidget *parent) : QPushButton{parent} {};
-
-private:
-  void mouseMoveEvent(QMouseEvent *) { emit drag(QCursor::pos()); }
-};
-
-namespace Ui {
-class ImageTextObject;
-}
-
-class ImageTextObject : public QWidget {
-  Q_OBJECT
-
-signals:
-  void selection();
+class HighlightLayer;
 
+// A recognized piece of text and its highlight. The highlight is only state
+// here, the tab's HighlightLayer paints it and routes the mouse to it.
+// Colors are read from the image the first time they are asked for or the
+// text is about to be removed, and copies carry them over.
+class ImageTextObject {
 public:
   bool wasSelected, isSelected, isPersistent, colorSet, drag;
   int fontSize;
-  cv::Scalar bgIntensity, fontIntensity;
-  cv::Mat *mat;
+  ImageBuffer *mat;
 
-  explicit ImageTextObject(QWidget *parent = nullptr, cv::Mat *__mat = nullptr);
-  ~ImageTextObject();
-  ImageTextObject(QWidget *parent, const ImageTextObject &old,
-                  Ui::MainWindow *__ui, cv::Mat *mat, Options *options);
-  ImageTextObject(QWidget *parent, ImageTextObject &&old, Ui::MainWindow *__ui,
-                  cv::Mat *mat, Options *options);
+  explicit ImageTextObject(ImageBuffer *__mat = nullptr);
+  ImageTextObject(HighlightLayer *layer, const ImageTextObject &old,
+                  ImageBuffer *mat, Options *options);
+  ImageTextObject(HighlightLayer *layer, ImageTextObject &&old,
+                  ImageBuffer *mat, Options *options);
 
-  Highlight *highlightButton;
   QPoint topLeft, bottomRight;
   QPair<QPoint, QPoint> lineSpace;
-  QVector<cv::Scalar> colorPalette;
 
   void setText(QString __text);
   QString getText() const;
+  const QVector<cv::Scalar> &getPalette();
+  cv::Scalar getFontColor();
+  void setFontColor(cv::Scalar color);
+  cv::Scalar getBackgroundColor();
+  void setColors(const ColorStats &stats);
+  bool isAnalysed() const;
   void initSizeAndPos();
-  void highlightSpaces();
-  void scaleAndPosition(double scalar);
+  QRect rect() const;
   void setImage(cv::Mat *__image);
   void setFilepath(QString __filepath);
 
   std::optional<QPair<cv::Mat, cv::Mat>> fillBackground(bool move = false);
+  std::optional<FillRequest> takeFill();
+  FillHole textHole();
   void scaleAndPosition(double x, double y);
   void selectHighlight();
   void highlight();
   void deselect();
   void showHighlight();
-  void setHighlightColor(QString colorStyle);
+  void paintHighlight(QRgb color);
+  void setHighlightColor(QRgb color);
   void reposition(QPoint shift, bool relative = true);
-  QString getHighlightColor();
+  QRgb getHighlightColor();
   void reset();
+
+  void show();
+  void hide();
+  void setDisabled(bool disabled);
+  bool isEnabled() const;
+  bool isHighlighted() const;
+  QRgb highlightFill() const;
   void unstageMove();
   static QString formatStyle(cv::Scalar);
   cv::Mat generateTextMask(const cv::Rect &roi);
 
 private:
   static bool moving;
+  HighlightLayer *layer;
   Options *options;
-  Ui::MainWindow *mUi;
   cv::Mat draw;
   std::optional<QPair<cv::Mat, cv::Mat>> textMask;
+  std::optional<FillRequest> pendingFill; // refined by the ImageFrame
 
-  Ui::ImageTextObject *ui;
   QString filepath;
   QString text;
-  QString colorStyle;
+  QRgb colorStyle, fill;
+  bool shown, highlighted, enabled;
+  bool analysed;
+  cv::Scalar bgIntensity, fontIntensity;
+  QVector<cv::Scalar> colorPalette;
 
   cv::Mat QImageToMat();
-  void determineBgColor();
-  void generatePalette();
+  void analyse();
   void bound();
   void neighboringFill();
+  void repaint();
+  void relocated(const QRect &from);
 
   std::optional<QPair<cv::Mat, cv::Mat>> inpaintingFill(bool move);
 };
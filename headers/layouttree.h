@@ -0,0 +1,46 @@
+﻿#ifndef LAYOUTTREE_H
+#define LAYOUTTREE_H
+
+#include "tesseract/baseapi.h"
+#include <QJsonArray>
+#include <QPoint>
+#include <QSize>
+#include <QString>
+#include <QVector>
+#include <tesseract/publictypes.h>
+
+typedef struct OcrBox {
+  QString text;
+  QPoint topLeft, bottomRight;
+} OcrBox;
+
+typedef struct LayoutNode {
+  tesseract::PageIteratorLevel level;
+  QString text;
+  QPoint topLeft, bottomRight;
+  float confidence;
+  int parent;
+} LayoutNode;
+
+// Block/paragraph/line/word/symbol hierarchy captured in one walk of the
+// result iterator. Nodes are stored flat in reading order with parents
+// before children, so any granularity can be produced without re-running OCR.
+class LayoutTree {
+public:
+  QVector<LayoutNode> nodes;
+
+  void capture(tesseract::ResultIterator *ri, const QSize &bounds);
+  void transform(double scale, int padding, const QPoint &offset,
+                 const QSize &bounds);
+  void append(const LayoutTree &other, int coreTop, int coreBottom);
+  QVector<OcrBox> boxes(tesseract::PageIteratorLevel RIL) const;
+  QString text() const;
+  int find(const QPoint &point, tesseract::PageIteratorLevel RIL) const;
+  bool isEmpty() const;
+
+  QJsonArray toJson() const;
+  static QJsonArray toJson(const QVector<OcrBox> &boxes);
+  static LayoutTree fromJson(const QJsonArray &array);
+};
+
+#endif // LAYOUTTREE_H
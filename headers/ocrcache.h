@@ -0,0 +1,42 @@
+﻿#ifndef OCRCACHE_H
+#define OCRCACHE_H
+
+#include "../headers/imageframe.h"
+#include "../headers/tiledimage.h"
+#include <QByteArray>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+constexpr const int DEFAULT_CACHE_SIZE_MB = 256;
+// bumped whenever the same settings start producing a different layout
+constexpr const int CACHE_VERSION = 2;
+
+// Content-addressed store of collect() results under ~/.config/tfi/cache/.
+// Entries are keyed by the decoded pixels plus every setting that changes the
+// recognized layout, and evicted least recently used once over the size limit.
+class OcrCache {
+public:
+  static OcrCache &instance();
+
+  static QByteArray key(const TiledImage &image, const OcrConfig &config);
+
+  bool lookup(const QByteArray &key, QString &text, LayoutTree &layout);
+  void store(const QByteArray &key, const QString &text,
+             const LayoutTree &layout);
+  void setMaxSize(int megabytes);
+
+private:
+  OcrCache();
+  OcrCache(const OcrCache &) = delete;
+  OcrCache &operator=(const OcrCache &) = delete;
+
+  QMutex mutex;
+  QString dir;
+  qint64 maxSize;
+  qint64 size;
+
+  void evict();
+};
+
+#endif // OCRCACHE_H
@@ -0,0 +1,32 @@
+﻿#ifndef OCRMONITOR_H
+#define OCRMONITOR_H
+
+#include "../headers/layouttree.h"
+#include <QMutex>
+#include <QVector>
+#include <atomic>
+#include <functional>
+
+// Shared between a recognition job and whoever started it. Workers report
+// progress per region and hand over each piece of the layout as soon as it is
+// recognized, cancel() stops Tesseract at its next word. The callbacks are
+// invoked on the worker threads.
+class OcrMonitor {
+public:
+  std::function<void(int percent)> progressed;
+  std::function<void(const LayoutTree &piece)> recognized;
+
+  void begin(int regions);
+  void update(int region, int percent);
+  void publish(const LayoutTree &piece);
+  void cancel();
+  bool isCancelled() const;
+
+private:
+  QMutex mutex;
+  QVector<int> percents;
+  int reported{-1};
+  std::atomic<bool> cancelled{false};
+};
+
+#endif // OCRMONITOR_H
@@ -0,0 +1,67 @@
+﻿#ifndef OCRSCHEDULER_H
+#define OCRSCHEDULER_H
+
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QFutureInterface>
+#include <QList>
+#include <QMutex>
+#include <QThreadPool>
+#include <functional>
+
+constexpr const int DEFAULT_OCR_MEMORY_MB = 2048;
+// the decoded image, its grayscale copy and Tesseract's own buffers
+constexpr const int OCR_BYTES_PER_PIXEL = 8;
+
+// running totals since start up, times in milliseconds
+typedef struct SchedulerStats {
+  int queued, running, finished;
+  qint64 waitMs, runMs, maxWaitMs;
+} SchedulerStats;
+
+// Runs extraction jobs from every tab on one bounded pool. Jobs of the visible
+// tab are started first, and a job is only admitted while the estimated
+// memory of everything running stays under the limit.
+class OcrScheduler {
+public:
+  static OcrScheduler &instance();
+
+  QFuture<void> submit(const void *owner, qint64 bytes,
+                       std::function<void()> task);
+  void withdraw(const void *owner);
+  void parallel(int count, const std::function<void(int)> &task);
+  void prioritize(const void *owner);
+  void setMaxJobs(int jobs);
+  void setMemoryLimit(int megabytes);
+  SchedulerStats stats();
+
+private:
+  typedef struct Job {
+    const void *owner;
+    qint64 bytes;
+    std::function<void()> task;
+    QFutureInterface<void> future;
+    QElapsedTimer waiting;
+  } Job;
+
+  OcrScheduler();
+  OcrScheduler(const OcrScheduler &) = delete;
+  OcrScheduler &operator=(const OcrScheduler &) = delete;
+
+  QMutex mutex;
+  QThreadPool pool;
+  QList<Job> queue;
+  const void *visible{nullptr};
+  int running{0};
+  int finished{0};
+  qint64 inFlight{0};
+  qint64 memoryLimit{DEFAULT_OCR_MEMORY_MB * 1024LL * 1024LL};
+  qint64 waitMs{0};
+  qint64 runMs{0};
+  qint64 maxWaitMs{0};
+
+  void dispatch();
+  void execute(Job job, qint64 waited);
+};
+
+#endif // OCRSCHEDULER_H
@@ -3,8 +3,27 @@
 
 #include "tesseract/baseapi.h"
 #include <QDialog>
+#include <QSettings>
 #include <tesseract/publictypes.h>
 
+constexpr const int DEFAULT_TILE_SIZE = 2048;
+constexpr const int DEFAULT_TILE_OVERLAP = 128;
+constexpr const int MIN_TILE_SIZE = 256;
+constexpr const int MAX_TILE_SIZE = 16384;
+constexpr const int DEFAULT_PADDING = 10;
+
+typedef struct OcrConfig {
+  tesseract::PageIteratorLevel RIL;
+  tesseract::OcrEngineMode OEM;
+  tesseract::PageSegMode PSM;
+  QString dataFile;
+  bool tiled;
+  int tileSize, tileOverlap;
+  bool cache;
+  bool preprocess, binarize, normalize;
+  int sourceDpi, targetDpi, padding;
+} OcrConfig;
+
 namespace Ui {
 class Options;
 }
@@ -13,7 +32,7 @@ class Options : public QDialog {
   Q_OBJECT
 
 public:
-  enum fillMethod { INPAINT, NEIGHBOR };
+  enum fillMethod { INPAINT, NEIGHBOR, TELEA, MULTISCALE };
   explicit Options(QWidget *parent = nullptr);
   ~Options();
   tesseract::PageIteratorLevel getRIL();
@@ -25,9 +44,41 @@ public:
   void setDataDir(QString dirName);
   void setDataFile(QString fileName);
   void setFillMethod(Options::fillMethod option);
+  void setTiled(bool tiled);
+  void setTileSize(int size);
+  void setTileOverlap(int overlap);
+  void setCache(bool cache);
+  void setCacheSize(int megabytes);
+  void setPreprocess(bool preprocess);
+  void setBinarize(bool binarize);
+  void setSourceDpi(int dpi);
+  void setTargetDpi(int dpi);
+  void setPadding(int padding);
+  void setNormalize(bool normalize);
+  void setOcrJobs(int jobs);
+  void setOcrMemory(int megabytes);
+  void setHistoryTabMemory(int megabytes);
+  void setHistoryMemory(int megabytes);
   Options::fillMethod getFillMethod();
   QString getDataDir();
   QString getDataFile();
+  bool getTiled();
+  int getTileSize();
+  int getTileOverlap();
+  bool getCache();
+  int getCacheSize();
+  bool getPreprocess();
+  bool getBinarize();
+  int getSourceDpi();
+  int getTargetDpi();
+  int getPadding();
+  bool getNormalize();
+  int getOcrJobs();
+  int getOcrMemory();
+  int getHistoryTabMemory();
+  int getHistoryMemory();
+  OcrConfig getConfig();
+  static OcrConfig configFromSettings(const QSettings &settings);
 
 private slots:
   void on_pushButton_3_clicked();
@@ -36,6 +87,8 @@ private slots:
 
 private:
   Ui::Options *ui;
+
+  static QString fillTip(Options::fillMethod option);
 };
 
 #endif // OPTIONS_H
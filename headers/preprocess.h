@@ -0,0 +1,30 @@
+﻿#ifndef PREPROCESS_H
+#define PREPROCESS_H
+
+#include "../headers/options.h"
+#include "opencv2/core/mat.hpp"
+#include "opencv2/imgproc.hpp"
+
+constexpr const int BINARIZE_BLOCK_SIZE = 31;
+constexpr const double BINARIZE_OFFSET = 15;
+constexpr const double RESCALE_MIN = 0.25;
+constexpr const double RESCALE_MAX = 4.0;
+constexpr const int GLYPH_HEIGHT_TARGET = 32;
+constexpr const int GLYPH_MIN_COUNT = 20;
+constexpr const int GLYPH_ANALYSIS_SIZE = 2048;
+constexpr const double NORMALIZE_TOLERANCE = 0.15;
+constexpr const int NORMALIZED_DPI = 300;
+
+// Single channel image handed to Tesseract, plus what is needed to map its
+// boxes back onto the original matrix.
+typedef struct Prepared {
+  cv::Mat image;
+  double scale;
+  int padding;
+  int dpi;
+} Prepared;
+
+Prepared preprocess(const cv::Mat &matrix, const OcrConfig &config);
+double glyphHeight(const cv::Mat &gray);
+
+#endif // PREPROCESS_H
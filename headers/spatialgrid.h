@@ -0,0 +1,32 @@
+﻿#ifndef SPATIALGRID_H
+#define SPATIALGRID_H
+
+#include <QHash>
+#include <QPair>
+#include <QRect>
+#include <QVector>
+
+class ImageTextObject;
+
+constexpr const int GRID_CELL_SIZE = 128;
+
+// Uniform grid over the boxes of the text objects, in image coordinates.
+// Every box is listed in each cell it overlaps, so a query only visits the
+// cells under its rectangle instead of every object on the page.
+class SpatialGrid {
+public:
+  void build(const QVector<ImageTextObject *> &objects);
+  void move(ImageTextObject *obj, const QRect &from);
+  QVector<ImageTextObject *> query(const QRect &rect) const;
+  bool contains(ImageTextObject *obj) const;
+  void clear();
+
+private:
+  QHash<QPair<int, int>, QVector<ImageTextObject *>> cells;
+  QHash<ImageTextObject *, int> ranks; // position in the object list
+
+  void insert(ImageTextObject *obj, const QRect &box);
+  void remove(ImageTextObject *obj, const QRect &box);
+};
+
+#endif // SPATIALGRID_H
@@ -0,0 +1,39 @@
+﻿#ifndef TILEDIMAGE_H
+#define TILEDIMAGE_H
+
+#include "opencv2/core/mat.hpp"
+#include <QHash>
+#include <QReadWriteLock>
+#include <QPair>
+#include <QVector>
+
+constexpr const int IMAGE_TILE_SIZE = 256;
+
+// Snapshot of an image that stays as it was while the image is edited. Tiles
+// are shared with the edited buffer until preserve() is called on a region
+// about to be written, which copies only the tiles it touches. read() hands
+// out any region, so readers can work a band or a strip at a time, several
+// of them at once.
+class TiledImage {
+public:
+  explicit TiledImage(const cv::Mat &image);
+
+  cv::Mat read(const cv::Rect &region) const;
+  void preserve(const cv::Rect &region);
+
+  int rows() const;
+  int cols() const;
+  int preserved() const;
+  QVector<cv::Rect> preservedRegions() const;
+
+private:
+  typedef QPair<int, int> Key;
+
+  cv::Mat image;
+  QHash<Key, cv::Mat> tiles;
+  mutable QReadWriteLock lock;
+
+  cv::Rect tile(const Key &key) const;
+};
+
+#endif // TILEDIMAGE_H
@@ -0,0 +1,10 @@
+﻿#ifndef TIMING_H
+#define TIMING_H
+
+#include <QLoggingCategory>
+
+// Timings of engine start up, recognition, selection and fills. Off unless
+// enabled with QT_LOGGING_RULES="tfi.timing.debug=true".
+Q_DECLARE_LOGGING_CATEGORY(lcTiming)
+
+#endif // TIMING_H
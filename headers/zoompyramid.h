@@ -0,0 +1,31 @@
+﻿#ifndef ZOOMPYRAMID_H
+#define ZOOMPYRAMID_H
+
+#include "opencv2/core/mat.hpp"
+#include "opencv2/imgproc.hpp"
+#include <QVector>
+
+constexpr const int PYRAMID_LEVELS = 4;
+
+// Lazily built chain of half resolution copies of the image. Zooming out is
+// resized from the nearest level at or above the requested scale, so a zoom
+// step costs about as much as its output rather than the full image. Edits
+// only rebuild their rectangle in the levels that already exist.
+class ZoomPyramid {
+public:
+  cv::Mat render(const cv::Mat &matrix, double scale, const cv::Rect &view);
+  void invalidate(const cv::Rect &region);
+  void replace(const cv::Mat &matrix, const cv::Rect &changed);
+  void clear();
+
+private:
+  cv::Mat base;
+  QVector<cv::Mat> levels; // levels[i] is base halved i + 1 times
+  QVector<cv::Rect> dirty; // in base coordinates
+
+  void sync(const cv::Mat &matrix);
+  const cv::Mat &level(int i);
+  void refresh();
+};
+
+#endif // ZOOMPYRAMID_H
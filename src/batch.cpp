@@ -0,0 +1,239 @@
+﻿#include "../headers/batch.h"
+#include "../headers/enginepool.h"
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSettings>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
+
+static const QStringList IMAGE_FILTERS{"*.png",  "*.jpeg", "*.jpg", "*.bmp",
+                                       "*.tif",  "*.tiff", "*.webp"};
+
+Batch::Batch(QVector<QString> args)
+    : valid{false}, useCache{true}, jobs{QThread::idealThreadCount()} {
+  valid = parse(args);
+}
+
+void Batch::usage() {
+  QTextStream err{stderr};
+  err << "usage: tfi --batch -o <output dir> [-j <jobs>] [--no-cache] "
+         "<files|dirs|globs>...\n";
+}
+
+bool Batch::parse(QVector<QString> args) {
+  args.removeAll("--batch");
+
+  for (auto i = 0; i < args.size(); i++) {
+    const auto &arg = args[i];
+    if (arg == "-o" || arg == "--output") {
+      if (++i >= args.size()) {
+        return false;
+      }
+      outputDir = QFileInfo{args[i]}.absoluteFilePath();
+    } else if (arg == "-j" || arg == "--jobs") {
+      if (++i >= args.size() || args[i].toInt() <= 0) {
+        return false;
+      }
+      jobs = args[i].toInt();
+    } else if (arg == "--no-cache") {
+      useCache = false;
+    } else {
+      inputs += expand(arg);
+    }
+  }
+
+  inputs.removeDuplicates();
+  return !outputDir.isEmpty() && !inputs.isEmpty();
+}
+
+QStringList Batch::expand(const QString &pattern) const {
+  QStringList files;
+  QFileInfo info{pattern};
+
+  if (info.isDir()) {
+    for (const auto &entry :
+         QDir{pattern}.entryInfoList(IMAGE_FILTERS, QDir::Files, QDir::Name)) {
+      files.push_back(entry.absoluteFilePath());
+    }
+  } else if (pattern.contains('*') || pattern.contains('?') ||
+             pattern.contains('[')) {
+    for (const auto &entry : QDir{info.path()}.entryInfoList(
+             {info.fileName()}, QDir::Files, QDir::Name)) {
+      files.push_back(entry.absoluteFilePath());
+    }
+  } else {
+    files.push_back(info.absoluteFilePath());
+  }
+
+  return files;
+}
+
+// results are named after the input, with a suffix when two inputs from
+// different directories share a base name
+void Batch::assignOutputNames() {
+  QHash<QString, int> used;
+
+  for (const auto &file : inputs) {
+    auto name = QFileInfo{file}.completeBaseName();
+    auto count = used[name]++;
+    outputNames[file] = count ? name + "_" + QString::number(count) : name;
+  }
+}
+
+Batch::Result Batch::process(const QString &file,
+                             const OcrConfig &config) const {
+  Result result{file, false, "", 0, 0, 0, 0};
+  QElapsedTimer timer;
+  timer.start();
+
+  cv::Mat matrix;
+  try {
+    matrix = cv::imread(file.toStdString(), cv::IMREAD_COLOR);
+  } catch (const cv::Exception &e) {
+    result.error = e.what();
+  }
+  result.loadMs = timer.restart();
+
+  if (matrix.empty()) {
+    if (result.error.isEmpty()) {
+      result.error = "failed to read image";
+    }
+    return result;
+  }
+
+  LayoutTree layout;
+  QString text = ImageFrame::collect(TiledImage{matrix}, config, layout);
+  const auto boxes = layout.boxes(config.RIL);
+  result.recognizeMs = timer.restart();
+  result.boxes = boxes.size();
+
+  QJsonObject json{
+      {"file", file},
+      {"width", matrix.cols},
+      {"height", matrix.rows},
+      {"boxes", LayoutTree::toJson(boxes)},
+      {"layout", layout.toJson()},
+  };
+
+  const auto base = outputDir + "/" + outputNames[file];
+  QFile textFile{base + ".txt"}, jsonFile{base + ".json"};
+  if (!textFile.open(QFile::WriteOnly) || !jsonFile.open(QFile::WriteOnly)) {
+    result.error = "failed to write results";
+    return result;
+  }
+  textFile.write(text.toUtf8());
+  jsonFile.write(QJsonDocument{json}.toJson());
+  result.writeMs = timer.elapsed();
+
+  result.ok = true;
+  return result;
+}
+
+int Batch::summarize(const QVector<Result> &results, qint64 wallMs) const {
+  QTextStream out{stdout};
+  qint64 load = 0, recognize = 0, write = 0;
+  int succeeded = 0, boxes = 0;
+  QJsonArray failures;
+
+  for (const auto &result : results) {
+    load += result.loadMs;
+    recognize += result.recognizeMs;
+    write += result.writeMs;
+    boxes += result.boxes;
+
+    if (result.ok) {
+      succeeded++;
+    } else {
+      failures.append(
+          QJsonObject{{"file", result.file}, {"error", result.error}});
+      out << "failed: " << result.file << " (" << result.error << ")\n";
+    }
+  }
+
+  const auto count = qMax(1, results.size());
+  const double throughput = wallMs ? 1000.0 * results.size() / wallMs : 0;
+
+  QJsonObject summary{
+      {"images", results.size()},
+      {"succeeded", succeeded},
+      {"failed", failures.size()},
+      {"failures", failures},
+      {"boxes", boxes},
+      {"jobs", jobs},
+      {"wallMs", wallMs},
+      {"imagesPerSecond", throughput},
+      {"meanLoadMs", static_cast<double>(load) / count},
+      {"meanRecognizeMs", static_cast<double>(recognize) / count},
+      {"meanWriteMs", static_cast<double>(write) / count},
+  };
+
+  QFile summaryFile{outputDir + "/summary.json"};
+  if (summaryFile.open(QFile::WriteOnly)) {
+    summaryFile.write(QJsonDocument{summary}.toJson());
+  }
+
+  out << results.size() << " images, " << succeeded << " ok, "
+      << failures.size() << " failed in " << wallMs << " ms ("
+      << QString::number(throughput, 'f', 2) << " images/s, " << jobs
+      << " jobs)\n";
+  out << "mean per image: load " << load / count << " ms, recognize "
+      << recognize / count << " ms, write " << write / count << " ms\n";
+
+  return failures.size();
+}
+
+int Batch::run() {
+  if (!valid) {
+    usage();
+    return 2;
+  }
+
+  if (!QDir{}.mkpath(outputDir)) {
+    QTextStream{stderr} << "failed to create " << outputDir << "\n";
+    return 1;
+  }
+
+  const QString path = QDir::homePath() + "/.config/tfi/";
+  QSettings settings{path + "settings.ini", QSettings::IniFormat};
+  OcrConfig config = Options::configFromSettings(settings);
+  config.cache = config.cache && useCache;
+  OcrCache::instance().setMaxSize(
+      settings.value("cache/MaxSizeMB", DEFAULT_CACHE_SIZE_MB).toInt());
+
+  // same data file lookup as MainWindow::scanSettings()
+  const auto dataDir = settings.value("tesseract/DataDir", path).toString();
+  QDir::setCurrent(QDir{dataDir}.exists() ? dataDir : path);
+  if (!EnginePool::instance().hasModel(config.dataFile)) {
+    QTextStream{stderr} << "data file " << config.dataFile
+                        << ".traineddata not found\n";
+    return 1;
+  }
+
+  assignOutputNames();
+  EnginePool::instance().setIdleLimit(jobs);
+
+  QThreadPool pool;
+  pool.setMaxThreadCount(jobs);
+
+  QElapsedTimer timer;
+  timer.start();
+
+  QVector<QFuture<Result>> futures;
+  for (const auto &file : inputs) {
+    futures.push_back(QtConcurrent::run(
+        &pool, [this, file, config] { return process(file, config); }));
+  }
+
+  QVector<Result> results;
+  for (auto &future : futures) {
+    results.push_back(future.result());
+  }
+
+  return summarize(results, timer.elapsed()) ? 1 : 0;
+}
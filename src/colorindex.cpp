@@ -0,0 +1,205 @@
+﻿#include "../headers/colorindex.h"
+#include "opencv2/core.hpp"
+#include <QHash>
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cstdint>
+
+constexpr const int QUANTIZE_SHIFT = 8 - QUANTIZE_BITS;
+
+static inline int code(const uchar *bgr) {
+  return ((bgr[0] >> QUANTIZE_SHIFT) << (2 * QUANTIZE_BITS)) |
+         ((bgr[1] >> QUANTIZE_SHIFT) << QUANTIZE_BITS) |
+         (bgr[2] >> QUANTIZE_SHIFT);
+}
+
+static inline uint32_t pack(const cv::Vec3b &bgr) {
+  return bgr[0] | (bgr[1] << 8) | (bgr[2] << 16);
+}
+
+// Samples every so many pixels, clusters them, then labels the image a strip
+// of tiles at a time. Each color is the most common sampled pixel of its
+// cluster rather than the cluster mean, so flat paper stays exactly white.
+ColorIndex::ColorIndex(const TiledImage &image,
+                       const std::function<bool()> &cancelled)
+    : lookup(1 << (3 * QUANTIZE_BITS), 0),
+      labels{image.rows(), image.cols(), CV_8U, cv::Scalar{0}} {
+  const qint64 total = static_cast<qint64>(image.rows()) * image.cols();
+  if (!total) {
+    return;
+  }
+  const qint64 step = qMax<qint64>(1, total / QUANTIZE_SAMPLES);
+
+  std::vector<cv::Vec3b> pixels;
+  pixels.reserve(total / step + 1);
+  qint64 next = 0;
+  for (auto y = 0; y < image.rows(); y += IMAGE_TILE_SIZE) {
+    if (cancelled && cancelled()) {
+      return;
+    }
+    const cv::Mat strip = image.read(cv::Rect{
+        0, y, image.cols(), qMin(IMAGE_TILE_SIZE, image.rows() - y)});
+    if (strip.type() != CV_8UC3) {
+      return;
+    }
+    const qint64 first = static_cast<qint64>(y) * image.cols();
+    for (; next < first + static_cast<qint64>(strip.total()); next += step) {
+      const auto i = static_cast<int>(next - first);
+      pixels.push_back(strip.at<cv::Vec3b>(i / strip.cols, i % strip.cols));
+    }
+  }
+
+  cv::Mat samples{static_cast<int>(pixels.size()), 3, CV_32F};
+  for (size_t i = 0; i < pixels.size(); i++) {
+    for (auto c = 0; c < 3; c++) {
+      samples.at<float>(static_cast<int>(i), c) = pixels[i][c];
+    }
+  }
+
+  const int k = qMin(QUANTIZE_COLORS, samples.rows);
+  cv::Mat assigned, centers;
+  cv::kmeans(samples, k, assigned,
+             cv::TermCriteria{cv::TermCriteria::COUNT | cv::TermCriteria::EPS,
+                              QUANTIZE_ITERATIONS, 1.0},
+             1, cv::KMEANS_PP_CENTERS, centers);
+
+  QVector<QHash<uint32_t, int>> counts(k);
+  for (size_t i = 0; i < pixels.size(); i++) {
+    counts[assigned.at<int>(static_cast<int>(i))][pack(pixels[i])]++;
+  }
+  colors.resize(k);
+  for (auto i = 0; i < k; i++) {
+    int best = 0;
+    for (auto it = counts[i].constBegin(); it != counts[i].constEnd(); ++it) {
+      if (it.value() > best) {
+        best = it.value();
+        colors[i] = cv::Scalar(it.key() & 0xff, (it.key() >> 8) & 0xff,
+                               (it.key() >> 16) & 0xff);
+      }
+    }
+  }
+
+  // each cell of the table goes to the center nearest its midpoint
+  const int levels = 1 << QUANTIZE_BITS;
+  const int half = 1 << (QUANTIZE_SHIFT - 1);
+  for (auto b = 0; b < levels; b++) {
+    for (auto g = 0; g < levels; g++) {
+      for (auto r = 0; r < levels; r++) {
+        const uchar mid[] = {
+            static_cast<uchar>((b << QUANTIZE_SHIFT) | half),
+            static_cast<uchar>((g << QUANTIZE_SHIFT) | half),
+            static_cast<uchar>((r << QUANTIZE_SHIFT) | half)};
+        float nearest = FLT_MAX;
+        for (auto i = 0; i < k; i++) {
+          const float *center = centers.ptr<float>(i);
+          float distance = 0;
+          for (auto c = 0; c < 3; c++) {
+            distance += (center[c] - mid[c]) * (center[c] - mid[c]);
+          }
+          if (distance < nearest) {
+            nearest = distance;
+            lookup[code(mid)] = static_cast<uchar>(i);
+          }
+        }
+      }
+    }
+  }
+
+  for (auto y = 0; y < image.rows(); y += IMAGE_TILE_SIZE) {
+    if (cancelled && cancelled()) {
+      colors.clear();
+      return;
+    }
+    const cv::Rect strip{0, y, image.cols(),
+                         qMin(IMAGE_TILE_SIZE, image.rows() - y)};
+    label(image.read(strip), labels(strip));
+  }
+}
+
+void ColorIndex::update(const cv::Mat &image, const cv::Rect &region) {
+  const cv::Rect r = region & cv::Rect{0, 0, labels.cols, labels.rows};
+  if (r.empty() || colors.isEmpty() || image.size() != labels.size()) {
+    return;
+  }
+  label(image(r), labels(r));
+}
+
+// The background is the most common label on the ring around the box and the
+// palette the most common of the rest inside it.
+ColorStats ColorIndex::analyse(const cv::Rect &box) const {
+  ColorStats stats{cv::Scalar{}, {}};
+
+  const cv::Rect r = box & cv::Rect{0, 0, labels.cols, labels.rows};
+  if (colors.isEmpty() || r.empty()) {
+    stats.palette.push_back(cv::Scalar{0, 0, 0});
+    return stats;
+  }
+
+  const int background = borderLabel(box);
+  stats.background = colors[background];
+
+  std::array<int, QUANTIZE_COLORS> counts{};
+  for (auto y = r.y; y < r.br().y; y++) {
+    const uchar *label = labels.ptr(y) + r.x;
+    for (auto x = 0; x < r.width; x++) {
+      counts[label[x]]++;
+    }
+  }
+  counts[background] = 0;
+
+  std::array<int, QUANTIZE_COLORS> order;
+  for (auto i = 0; i < QUANTIZE_COLORS; i++) {
+    order[i] = i;
+  }
+  const auto top = order.begin() + qMin(PALETTE_LIMIT, QUANTIZE_COLORS);
+  std::partial_sort(order.begin(), top, order.end(),
+                    [&counts](int lhs, int rhs) {
+                      return counts[lhs] > counts[rhs];
+                    });
+
+  for (auto it = order.begin(); it != top && counts[*it]; ++it) {
+    stats.palette.push_back(colors[*it]);
+  }
+  if (stats.palette.isEmpty()) {
+    stats.palette.push_back(cv::Scalar{0, 0, 0});
+  }
+  return stats;
+}
+
+cv::Size ColorIndex::size() const { return labels.size(); }
+
+void ColorIndex::label(const cv::Mat &image, cv::Mat out) const {
+  for (auto y = 0; y < image.rows; y++) {
+    const uchar *pixel = image.ptr(y);
+    uchar *label = out.ptr(y);
+    for (auto x = 0; x < image.cols; x++, pixel += 3) {
+      label[x] = lookup[code(pixel)];
+    }
+  }
+}
+
+int ColorIndex::borderLabel(const cv::Rect &box) const {
+  auto left{box.x}, top{box.y};
+  auto right{box.br().x}, bottom{box.br().y};
+
+  (left > 0) ? left -= 1 : left;
+  (right < labels.cols - 1) ? right += 1 : right;
+  (top > 0) ? top -= 1 : top;
+  (bottom < labels.rows - 1) ? bottom += 1 : bottom;
+
+  (right == labels.cols) ? right -= 1 : right;
+  (bottom == labels.rows) ? bottom -= 1 : bottom;
+
+  std::array<int, QUANTIZE_COLORS> counts{};
+  const uchar *topRow = labels.ptr(top), *bottomRow = labels.ptr(bottom);
+  for (auto i = left; i < right; i++) {
+    counts[topRow[i]]++;
+    counts[bottomRow[i]]++;
+  }
+  for (auto i = top; i < bottom; i++) {
+    counts[labels.ptr(i)[left]]++;
+    counts[labels.ptr(i)[right]]++;
+  }
+  return std::max_element(counts.begin(), counts.end()) - counts.begin();
+}
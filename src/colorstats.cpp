@@ -0,0 +1,202 @@
+﻿#include "../headers/colorstats.h"
+#include "opencv2/imgproc.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+#include <vector>
+
+constexpr const uint32_t EMPTY_KEY = 0xffffffff;
+constexpr const int MIN_TABLE_BITS = 6;
+
+// Open addressing count of packed colors, grown while more than half full
+typedef struct ColorTable {
+  std::vector<uint32_t> keys;
+  std::vector<int> counts;
+  int bits, used;
+} ColorTable;
+
+static inline uint32_t pack(const uchar *bgr) {
+  return bgr[0] | (bgr[1] << 8) | (bgr[2] << 16);
+}
+
+static inline cv::Scalar unpack(uint32_t key) {
+  return cv::Scalar(key & 0xff, (key >> 8) & 0xff, (key >> 16) & 0xff);
+}
+
+// the fixed point weights of cv::COLOR_BGR2GRAY, so the split matches
+// textMask() to the pixel
+static inline int gray(uint32_t key) {
+  return ((key & 0xff) * 3735 + ((key >> 8) & 0xff) * 19235 +
+          ((key >> 16) & 0xff) * 9798 + (1 << 14)) >>
+         15;
+}
+
+static ColorTable colorTable(size_t expected) {
+  int bits = MIN_TABLE_BITS;
+  while ((size_t{1} << bits) < 2 * expected && bits < 24) {
+    bits++;
+  }
+  return ColorTable{std::vector<uint32_t>(size_t{1} << bits, EMPTY_KEY),
+                    std::vector<int>(size_t{1} << bits, 0), bits, 0};
+}
+
+static inline size_t slot(const ColorTable &table, uint32_t key) {
+  size_t i = (key * 2654435761u) >> (32 - table.bits);
+  const size_t mask = table.keys.size() - 1;
+  while (table.keys[i] != key && table.keys[i] != EMPTY_KEY) {
+    i = (i + 1) & mask;
+  }
+  return i;
+}
+
+static void add(ColorTable &table, uint32_t key, int count = 1);
+
+static void grow(ColorTable &table) {
+  ColorTable bigger{std::vector<uint32_t>(table.keys.size() * 2, EMPTY_KEY),
+                    std::vector<int>(table.keys.size() * 2, 0),
+                    table.bits + 1, 0};
+  for (size_t i = 0; i < table.keys.size(); i++) {
+    if (table.keys[i] != EMPTY_KEY) {
+      add(bigger, table.keys[i], table.counts[i]);
+    }
+  }
+  table = std::move(bigger);
+}
+
+static void add(ColorTable &table, uint32_t key, int count) {
+  size_t i = slot(table, key);
+  if (table.keys[i] == EMPTY_KEY) {
+    if (2 * (table.used + 1) > static_cast<int>(table.keys.size())) {
+      grow(table);
+      i = slot(table, key);
+    }
+    table.keys[i] = key;
+    table.used++;
+  }
+  table.counts[i] += count;
+}
+
+// same threshold as cv::THRESH_OTSU, the gray levels above it are set
+static int otsu(const int (&histogram)[256], int total) {
+  double mu = 0;
+  for (auto i = 0; i < 256; i++) {
+    mu += i * static_cast<double>(histogram[i]);
+  }
+  mu /= total;
+
+  double q1 = 0, mu1 = 0, best = 0;
+  int threshold = 0;
+  for (auto i = 0; i < 256; i++) {
+    const double p = static_cast<double>(histogram[i]) / total;
+    mu1 *= q1;
+    q1 += p;
+    const double q2 = 1. - q1;
+    if (std::min(q1, q2) < FLT_EPSILON || std::max(q1, q2) > 1. - FLT_EPSILON) {
+      continue;
+    }
+    mu1 = (mu1 + i * p) / q1;
+    const double mu2 = (mu - q1 * mu1) / q2;
+    const double sigma = q1 * q2 * (mu1 - mu2) * (mu1 - mu2);
+    if (sigma > best) {
+      best = sigma;
+      threshold = i;
+    }
+  }
+  return threshold;
+}
+
+ColorStats analyseColors(const cv::Mat &image, const cv::Rect &box) {
+  ColorStats stats{borderColor(image, box), {}};
+
+  const cv::Rect r = box & cv::Rect{0, 0, image.cols, image.rows};
+  if (r.width > 0 && r.height > 0) {
+    int histogram[256] = {};
+    ColorTable table = colorTable(r.area());
+    for (auto y = r.y; y < r.br().y; y++) {
+      const uchar *pixel = image.ptr(y) + 3 * r.x;
+      for (auto x = 0; x < r.width; x++, pixel += 3) {
+        const uint32_t key = pack(pixel);
+        histogram[gray(key)]++;
+        add(table, key);
+      }
+    }
+
+    // the text is the set side of the mask textMask() would make
+    const int threshold = otsu(histogram, r.area());
+    int whites = 0;
+    for (auto i = threshold + 1; i < 256; i++) {
+      whites += histogram[i];
+    }
+    const bool inverted =
+        static_cast<double>(whites) / r.area() > INVERT_MASK_THRESH;
+
+    // black is never offered, as before when it stood for unmasked pixels
+    QVector<QPair<int, uint32_t>> counts;
+    for (size_t i = 0; i < table.keys.size(); i++) {
+      const uint32_t key = table.keys[i];
+      if (key != EMPTY_KEY && key && (gray(key) > threshold) != inverted) {
+        counts.push_back({table.counts[i], key});
+      }
+    }
+    const auto top = counts.begin() + qMin(PALETTE_LIMIT, counts.size());
+    std::partial_sort(counts.begin(), top, counts.end(),
+                      [](const QPair<int, uint32_t> &lhs,
+                         const QPair<int, uint32_t> &rhs) {
+                        return lhs.first > rhs.first;
+                      });
+    for (auto it = counts.begin(); it != top; ++it) {
+      stats.palette.push_back(unpack(it->second));
+    }
+  }
+  if (stats.palette.isEmpty()) {
+    stats.palette.push_back(cv::Scalar{0, 0, 0});
+  }
+  return stats;
+}
+
+// Otsu split of the gray levels, flipped when most of the box comes out
+// white so the text is always the set part
+cv::Mat textMask(const cv::Mat &roi) {
+  cv::Mat mask;
+  cv::cvtColor(roi, mask, cv::COLOR_BGR2GRAY);
+  cv::threshold(mask, mask, 0, 255, cv::THRESH_OTSU);
+
+  const double whites =
+      static_cast<double>(cv::countNonZero(mask)) / mask.total();
+  if (whites > INVERT_MASK_THRESH) {
+    mask = ~mask;
+  }
+  return mask;
+}
+
+// most frequent color on the ring of pixels just outside box
+cv::Scalar borderColor(const cv::Mat &image, const cv::Rect &box) {
+  auto left{box.x}, top{box.y};
+  auto right{box.br().x}, bottom{box.br().y};
+
+  (left > 0) ? left -= 1 : left;
+  (right < image.cols - 1) ? right += 1 : right;
+  (top > 0) ? top -= 1 : top;
+  (bottom < image.rows - 1) ? bottom += 1 : bottom;
+
+  (right == image.cols) ? right -= 1 : right;
+  (bottom == image.rows) ? bottom -= 1 : bottom;
+
+  ColorTable table = colorTable(2 * qMax(0, right - left) +
+                                2 * qMax(0, bottom - top));
+  const uchar *topRow = image.ptr(top), *bottomRow = image.ptr(bottom);
+  for (auto i = left; i < right; i++) {
+    add(table, pack(topRow + 3 * i));
+    add(table, pack(bottomRow + 3 * i));
+  }
+  for (auto i = top; i < bottom; i++) {
+    add(table, pack(image.ptr(i) + 3 * left));
+    add(table, pack(image.ptr(i) + 3 * right));
+  }
+
+  const auto best = std::max_element(table.counts.begin(), table.counts.end());
+  if (*best == 0) {
+    return cv::Scalar{};
+  }
+  return unpack(table.keys[best - table.counts.begin()]);
+}
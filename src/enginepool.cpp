@@ -0,0 +1,181 @@
+﻿#include "../headers/enginepool.h"
+#include "../headers/timing.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QResource>
+#include <QtConcurrent/QtConcurrent>
+
+EnginePool &EnginePool::instance() {
+  static EnginePool pool;
+  return pool;
+}
+
+EnginePool::~EnginePool() {
+  for (const auto &engines : idle) {
+    for (const auto &api : engines) {
+      destroy(api);
+    }
+  }
+  for (const auto &file : mapped) {
+    delete file;
+  }
+}
+
+// Looked up relative to the current directory like Tesseract itself does,
+// and kept for the life of the process.
+EnginePool::Model EnginePool::model(const QString &dataFile) {
+  const auto path = QFileInfo{dataFile + ".traineddata"}.absoluteFilePath();
+
+  QMutexLocker lock{&mutex};
+  if (models.contains(path)) {
+    return models[path];
+  }
+
+  Model found{nullptr, 0};
+  auto *file = new QFile{path};
+  if (file->open(QFile::ReadOnly)) {
+    found = Model{file->map(0, file->size()), file->size()};
+  }
+  if (found.data) {
+    mapped.push_back(file);
+  } else {
+    delete file;
+  }
+
+  if (!found.data && dataFile == "eng") {
+    QResource resource{BUNDLED_MODEL};
+    if (resource.isValid() && !resource.isCompressed()) {
+      found = Model{resource.data(), resource.size()};
+    } else {
+      // only when rcc compressed the model anyway
+      QFile qrcFile{BUNDLED_MODEL};
+      if (qrcFile.open(QFile::ReadOnly)) {
+        buffers.push_back(qrcFile.readAll());
+        const auto &bytes = buffers.last();
+        found = Model{reinterpret_cast<const uchar *>(bytes.constData()),
+                      bytes.size()};
+      }
+    }
+  }
+
+  if (found.data) {
+    models[path] = found;
+  }
+  return found;
+}
+
+bool EnginePool::hasModel(const QString &dataFile) {
+  return model(dataFile).data != nullptr;
+}
+
+tesseract::TessBaseAPI *EnginePool::create(const Key &key) {
+  tesseract::TessBaseAPI *api = new tesseract::TessBaseAPI();
+  auto data = key.first.toLocal8Bit();
+  const auto OEM = static_cast<tesseract::OcrEngineMode>(key.second);
+  const Model buffer = model(key.first);
+
+  QElapsedTimer timer;
+  timer.start();
+  int failed;
+  if (buffer.data) {
+    failed = api->Init(reinterpret_cast<const char *>(buffer.data),
+                       static_cast<int>(buffer.size), data.data(), OEM,
+                       nullptr, 0, nullptr, nullptr, false, nullptr);
+  } else {
+    failed = api->Init(nullptr, data.data(), OEM);
+  }
+  if (failed) {
+    qDebug() << "Failed to initialize engine for" << key.first;
+    delete api;
+    return nullptr;
+  }
+  qCDebug(lcTiming) << "Engine init" << key.first << "took"
+                    << timer.elapsed() << "ms";
+
+  return api;
+}
+
+void EnginePool::destroy(tesseract::TessBaseAPI *api) {
+  api->End();
+  delete api;
+}
+
+tesseract::TessBaseAPI *EnginePool::acquire(const QString &dataFile,
+                                            tesseract::OcrEngineMode OEM) {
+  Key key{dataFile, OEM};
+  int gen;
+  {
+    QMutexLocker lock{&mutex};
+    gen = generation;
+    auto &engines = idle[key];
+    if (!engines.isEmpty()) {
+      auto *api = engines.takeLast();
+      leased[api] = {key, gen};
+      return api;
+    }
+  }
+
+  // model load happens outside the lock so other keys aren't blocked
+  auto *api = create(key);
+  if (!api) {
+    return nullptr;
+  }
+
+  QMutexLocker lock{&mutex};
+  leased[api] = {key, gen};
+  return api;
+}
+
+void EnginePool::release(tesseract::TessBaseAPI *api) {
+  if (!api) {
+    return;
+  }
+  api->Clear();
+
+  {
+    QMutexLocker lock{&mutex};
+    auto lease = leased.take(api);
+    auto &engines = idle[lease.first];
+    if (lease.second == generation && engines.size() < idleLimit) {
+      engines.push_back(api);
+      return;
+    }
+  }
+
+  // stale after an Options change, or the pool is already full
+  destroy(api);
+}
+
+void EnginePool::warm(const QString &dataFile, tesseract::OcrEngineMode OEM) {
+  {
+    QMutexLocker lock{&mutex};
+    if (!idle.value({dataFile, OEM}).isEmpty()) {
+      return;
+    }
+  }
+
+  QtConcurrent::run([this, dataFile, OEM] { release(acquire(dataFile, OEM)); });
+}
+
+void EnginePool::rebuild() {
+  QHash<Key, QVector<tesseract::TessBaseAPI *>> stale;
+  {
+    QMutexLocker lock{&mutex};
+    ++generation;
+    stale.swap(idle);
+  }
+
+  // engines currently leased are dropped on release
+  for (const auto &engines : stale) {
+    for (const auto &api : engines) {
+      destroy(api);
+    }
+  }
+}
+
+void EnginePool::setIdleLimit(int limit) {
+  QMutexLocker lock{&mutex};
+  idleLimit = limit;
+}
@@ -0,0 +1,84 @@
+﻿#include "../headers/fillengine.h"
+#include "opencv2/imgproc.hpp"
+#include "../headers/timing.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <opencv2/photo.hpp>
+
+// Structure from a downscaled pass, detail from the full size one. Deep in
+// the hole the coarse fill takes over, since the fine one only reaches
+// FILL_RADIUS pixels in from the edge before it smears.
+static cv::Mat multiScaleFill(const cv::Mat &source, const cv::Mat &mask) {
+  cv::Mat fine;
+  cv::inpaint(source, mask, fine, FILL_RADIUS, cv::INPAINT_NS);
+
+  cv::Mat image = source, hole = mask;
+  auto levels = 0;
+  while (levels < MULTISCALE_LEVELS &&
+         qMin(image.rows, image.cols) / 2 >= MULTISCALE_MIN_SIZE) {
+    cv::pyrDown(image, image);
+    cv::resize(hole, hole, image.size(), 0, 0, cv::INTER_AREA);
+    cv::threshold(hole, hole, 0, 255, cv::THRESH_BINARY);
+    levels++;
+  }
+  if (!levels) {
+    return fine;
+  }
+
+  cv::Mat coarse;
+  cv::inpaint(image, hole, coarse, FILL_RADIUS, cv::INPAINT_NS);
+  cv::resize(coarse, coarse, source.size(), 0, 0, cv::INTER_LINEAR);
+
+  cv::Mat depth;
+  cv::distanceTransform(mask, depth, cv::DIST_L2, 3);
+  depth = cv::min(depth / (FILL_RADIUS << levels), 1.0);
+  cv::cvtColor(depth, depth, cv::COLOR_GRAY2BGR);
+
+  cv::Mat blend, from;
+  fine.convertTo(blend, CV_32FC3);
+  coarse.convertTo(from, CV_32FC3);
+  blend += (from - blend).mul(depth);
+  blend.convertTo(fine, CV_8UC3);
+  return fine;
+}
+
+cv::Mat fillRegion(const cv::Mat &source, const cv::Mat &mask,
+                   Options::fillMethod method, const cv::Scalar &background) {
+  QElapsedTimer timer;
+  timer.start();
+
+  cv::Mat dst;
+  switch (method) {
+  case Options::NEIGHBOR:
+    dst = source.clone();
+    dst.setTo(background, mask);
+    break;
+  case Options::TELEA:
+    cv::inpaint(source, mask, dst, FILL_RADIUS, cv::INPAINT_TELEA);
+    break;
+  case Options::MULTISCALE:
+    dst = multiScaleFill(source, mask);
+    break;
+  default:
+    cv::inpaint(source, mask, dst, FILL_RADIUS, cv::INPAINT_NS);
+    break;
+  }
+
+  qCDebug(lcTiming) << "Filled" << source.cols << "x" << source.rows << "with"
+                    << fillName(method) << "in" << timer.nsecsElapsed() / 1000
+                    << "us";
+  return dst;
+}
+
+QString fillName(Options::fillMethod method) {
+  switch (method) {
+  case Options::NEIGHBOR:
+    return "neighboring fill";
+  case Options::TELEA:
+    return "Telea inpainting";
+  case Options::MULTISCALE:
+    return "multi-scale inpainting";
+  default:
+    return "Navier-Stokes inpainting";
+  }
+}
@@ -0,0 +1,263 @@
+﻿#include "../headers/fillscheduler.h"
+#include "opencv2/imgproc.hpp"
+#include "../headers/timing.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QtConcurrent/QtConcurrent>
+#include <algorithm>
+#include <functional>
+#include <numeric>
+
+// holes this close share context and are filled in the same pass
+static int contextPadding(Options::fillMethod method) {
+  return method == Options::MULTISCALE ? FILL_RADIUS << MULTISCALE_LEVELS
+                                       : FILL_RADIUS + 1;
+}
+
+// Where part of a pass goes in the image. Tiles of one group carry a
+// weight for the blend; everything else is copied through the mask.
+typedef struct FillPiece {
+  cv::Rect from, to;
+  int group;
+  cv::Mat weight;
+} FillPiece;
+
+typedef struct FillPass {
+  cv::Mat source, mask;
+  QVector<FillPiece> pieces;
+} FillPass;
+
+typedef struct FillGroup {
+  cv::Rect region;
+  cv::Mat mask;
+} FillGroup;
+
+static int root(QVector<int> &parent, int i) {
+  while (parent[i] != i) {
+    i = parent[i] = parent[parent[i]];
+  }
+  return i;
+}
+
+// holes whose padded regions touch end up in one group
+static QVector<FillGroup> groupHoles(const QVector<FillHole> &holes,
+                                     int padding) {
+  QVector<int> order(holes.size()), parent(holes.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::iota(parent.begin(), parent.end(), 0);
+  std::sort(order.begin(), order.end(), [&holes](int lhs, int rhs) {
+    return holes[lhs].region.x < holes[rhs].region.x;
+  });
+
+  for (auto i = 0; i < order.size(); i++) {
+    const cv::Rect &a = holes[order[i]].region;
+    const cv::Rect reach{a.x - padding, a.y - padding, a.width + 2 * padding,
+                         a.height + 2 * padding};
+    for (auto j = i + 1;
+         j < order.size() && holes[order[j]].region.x < reach.br().x; j++) {
+      if (!(reach & holes[order[j]].region).empty()) {
+        parent[root(parent, order[j])] = root(parent, order[i]);
+      }
+    }
+  }
+
+  QHash<int, int> index;
+  QVector<FillGroup> groups;
+  for (auto i = 0; i < holes.size(); i++) {
+    const int r = root(parent, i);
+    if (!index.contains(r)) {
+      index[r] = groups.size();
+      groups.push_back(FillGroup{holes[i].region, {}});
+    } else {
+      groups[index[r]].region |= holes[i].region;
+    }
+  }
+  for (auto &group : groups) {
+    group.mask = cv::Mat::zeros(group.region.size(), CV_8U);
+  }
+  for (auto i = 0; i < holes.size(); i++) {
+    FillGroup &group = groups[index[root(parent, i)]];
+    cv::Mat part = group.mask(holes[i].region - group.region.tl());
+    part |= holes[i].mask;
+  }
+  return groups;
+}
+
+// 1 inside the core, falling off across the overlap on the sides where
+// the next tile takes over
+static cv::Mat tileWeight(const cv::Rect &tile, const cv::Rect &core) {
+  const auto ramp = [](int size, int before, int after) {
+    cv::Mat w{1, size, CV_32F, cv::Scalar{1}};
+    for (auto i = 0; i < 2 * before && i < size; i++) {
+      w.at<float>(i) = qMin(1.0f, (i + 0.5f) / (2 * before));
+    }
+    for (auto i = 0; i < 2 * after && i < size; i++) {
+      w.at<float>(size - 1 - i) =
+          qMin(w.at<float>(size - 1 - i), (i + 0.5f) / (2 * after));
+    }
+    return w;
+  };
+
+  const cv::Mat x =
+      ramp(tile.width, core.x - tile.x, tile.br().x - core.br().x);
+  const cv::Mat y =
+      ramp(tile.height, core.y - tile.y, tile.br().y - core.br().y);
+  return y.t() * x;
+}
+
+static void addTiles(const cv::Mat &image, const FillGroup &group, int id,
+                     QVector<FillPass> &passes) {
+  const cv::Rect bounds{cv::Point{0, 0}, group.region.size()};
+  for (auto y = 0; y < bounds.height; y += FILL_TILE_SIZE) {
+    for (auto x = 0; x < bounds.width; x += FILL_TILE_SIZE) {
+      const cv::Rect core =
+          cv::Rect{x, y, FILL_TILE_SIZE, FILL_TILE_SIZE} & bounds;
+      const cv::Rect tile =
+          cv::Rect{core.x - FILL_TILE_OVERLAP, core.y - FILL_TILE_OVERLAP,
+                   core.width + 2 * FILL_TILE_OVERLAP,
+                   core.height + 2 * FILL_TILE_OVERLAP} &
+          bounds;
+      if (!cv::countNonZero(group.mask(core))) {
+        continue;
+      }
+
+      const cv::Rect to = tile + group.region.tl();
+      passes.push_back(FillPass{
+          image(to).clone(), group.mask(tile).clone(),
+          {FillPiece{cv::Rect{cv::Point{0, 0}, tile.size()}, to, id,
+                     tileWeight(tile, core)}}});
+    }
+  }
+}
+
+// Shelf packs the groups into atlases of about FILL_ATLAS_AREA pixels, each
+// with the padding of real pixels around it that a fill in place would see.
+// Only the part beyond the image edge is replicated.
+static void addBatches(const cv::Mat &image, QVector<FillGroup> small,
+                       int padding, QVector<FillPass> &passes) {
+  std::sort(small.begin(), small.end(),
+            [](const FillGroup &lhs, const FillGroup &rhs) {
+              return lhs.region.height > rhs.region.height;
+            });
+
+  const cv::Rect bounds{0, 0, image.cols, image.rows};
+  for (auto first = 0; first < small.size();) {
+    // place a batch of groups, then copy them into an atlas of that size
+    QVector<cv::Rect> places;
+    int x = 0, y = 0, shelf = 0, width = 0, area = 0;
+    auto last = first;
+    for (; last < small.size() && area < FILL_ATLAS_AREA; last++) {
+      const cv::Size size = small[last].region.size() +
+                            cv::Size{2 * padding, 2 * padding};
+      if (x > 0 && x + size.width > FILL_ATLAS_WIDTH) {
+        x = 0;
+        y += shelf;
+        shelf = 0;
+      }
+      places.push_back(cv::Rect{cv::Point{x, y}, size});
+      x += size.width;
+      shelf = qMax(shelf, size.height);
+      width = qMax(width, x);
+      area += size.area();
+    }
+
+    FillPass pass{cv::Mat{y + shelf, width, image.type(), cv::Scalar{}},
+                  cv::Mat::zeros(y + shelf, width, CV_8U),
+                  {}};
+    for (auto i = first; i < last; i++) {
+      const FillGroup &group = small[i];
+      const cv::Rect &place = places[i - first];
+      const cv::Rect core{place.x + padding, place.y + padding,
+                          group.region.width, group.region.height};
+
+      const cv::Rect reach{group.region.tl() - cv::Point{padding, padding},
+                           place.size()};
+      const cv::Rect inside = reach & bounds;
+      cv::Mat block = pass.source(place);
+      cv::copyMakeBorder(image(inside), block, inside.y - reach.y,
+                         reach.br().y - inside.br().y, inside.x - reach.x,
+                         reach.br().x - inside.br().x, cv::BORDER_REPLICATE);
+      group.mask.copyTo(pass.mask(core));
+      pass.pieces.push_back(FillPiece{core, group.region, -1, {}});
+    }
+    passes.push_back(pass);
+    first = last;
+  }
+}
+
+void fillHoles(cv::Mat &image, const QVector<FillHole> &holes,
+               Options::fillMethod method) {
+  if (holes.isEmpty()) {
+    return;
+  }
+  QElapsedTimer timer;
+  timer.start();
+
+  const int padding = contextPadding(method);
+  const auto groups = groupHoles(holes, padding);
+
+  QVector<FillPass> passes;
+  QVector<FillGroup> small;
+  QVector<int> tiled;
+  for (auto i = 0; i < groups.size(); i++) {
+    const FillGroup &group = groups[i];
+    if (group.region.area() <= FILL_BATCH_AREA) {
+      small.push_back(group);
+    } else if (group.region.width > FILL_TILE_SIZE + FILL_TILE_OVERLAP ||
+               group.region.height > FILL_TILE_SIZE + FILL_TILE_OVERLAP) {
+      addTiles(image, group, i, passes);
+      tiled.push_back(i);
+    } else {
+      passes.push_back(FillPass{
+          image(group.region).clone(), group.mask,
+          {FillPiece{cv::Rect{cv::Point{0, 0}, group.region.size()},
+                     group.region, -1, {}}}});
+    }
+  }
+  addBatches(image, small, padding, passes);
+
+  const std::function<cv::Mat(const FillPass &)> fill =
+      [method](const FillPass &pass) {
+        return fillRegion(pass.source, pass.mask, method, cv::Scalar{});
+      };
+  const auto results =
+      QtConcurrent::blockingMapped<QVector<cv::Mat>>(passes, fill);
+
+  // tiles are summed by weight per group, the rest goes straight in
+  QHash<int, QPair<cv::Mat, cv::Mat>> blends;
+  for (const auto i : tiled) {
+    blends[i] = {cv::Mat::zeros(groups[i].region.size(), CV_32FC3),
+                 cv::Mat::zeros(groups[i].region.size(), CV_32F)};
+  }
+  for (auto i = 0; i < passes.size(); i++) {
+    for (const auto &piece : passes[i].pieces) {
+      if (piece.group < 0) {
+        results[i](piece.from).copyTo(image(piece.to),
+                                      passes[i].mask(piece.from));
+        continue;
+      }
+
+      auto &blend = blends[piece.group];
+      const cv::Rect at = piece.to - groups[piece.group].region.tl();
+      cv::Mat pixels, weight;
+      results[i](piece.from).convertTo(pixels, CV_32FC3);
+      cv::cvtColor(piece.weight, weight, cv::COLOR_GRAY2BGR);
+      cv::Mat sum = blend.first(at), total = blend.second(at);
+      sum += pixels.mul(weight);
+      total += piece.weight;
+    }
+  }
+  for (auto it = blends.begin(); it != blends.end(); ++it) {
+    const FillGroup &group = groups[it.key()];
+    cv::Mat total, pixels;
+    cv::cvtColor(cv::max(it.value().second, 1e-6), total,
+                 cv::COLOR_GRAY2BGR);
+    cv::divide(it.value().first, total, pixels);
+    pixels.convertTo(pixels, image.type());
+    pixels.copyTo(image(group.region), group.mask);
+  }
+
+  qCDebug(lcTiming) << "Filled" << holes.size() << "holes in" << passes.size()
+                    << "passes," << tiled.size() << "groups tiled and"
+                    << small.size() << "batched, in" << timer.elapsed() << "ms";
+}
@@ -0,0 +1,74 @@
+﻿#include "../headers/highlightlayer.h"
+
+HighlightLayer::HighlightLayer() : objects{nullptr} {
+  setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
+  setAcceptedMouseButtons(Qt::NoButton);
+  setZValue(1);
+}
+
+void HighlightLayer::setObjects(const QVector<ImageTextObject *> *__objects) {
+  objects = __objects;
+  reindex();
+}
+
+void HighlightLayer::reindex() {
+  if (objects) {
+    grid.build(*objects);
+  } else {
+    grid.clear();
+  }
+  update();
+}
+
+// keeps the grid in step with a box that was moved or resized
+void HighlightLayer::moved(ImageTextObject *obj, const QRect &from) {
+  grid.move(obj, from);
+  update();
+}
+
+void HighlightLayer::setBounds(const QSize &size) {
+  prepareGeometryChange();
+  bounds = QRectF{QPointF{0, 0}, size};
+}
+
+// topmost highlight under point, in image coordinates, that would have
+// received the click
+ImageTextObject *HighlightLayer::objectAt(const QPoint &point) const {
+  const auto candidates = grid.query(QRect{point, point});
+  for (auto i = candidates.size() - 1; i >= 0; i--) {
+    const auto obj = candidates[i];
+    if (obj->isHighlighted() && obj->isEnabled() &&
+        obj->rect().contains(point)) {
+      return obj;
+    }
+  }
+  return nullptr;
+}
+
+// enabled objects whose boxes, corners included, overlap box
+QVector<ImageTextObject *> HighlightLayer::objectsIn(const QRect &box) const {
+  QVector<ImageTextObject *> found;
+  for (const auto &obj : grid.query(box)) {
+    if (obj->isEnabled() &&
+        box.intersects(QRect{obj->topLeft, obj->bottomRight})) {
+      found.push_back(obj);
+    }
+  }
+  return found;
+}
+
+QRectF HighlightLayer::boundingRect() const { return bounds; }
+
+void HighlightLayer::paint(QPainter *painter,
+                           const QStyleOptionGraphicsItem *option, QWidget *) {
+  const QRect exposed = option->exposedRect.toAlignedRect();
+  for (const auto &obj : grid.query(exposed)) {
+    if (!obj->isHighlighted()) {
+      continue;
+    }
+    const QRect rect = obj->rect();
+    if (rect.intersects(exposed)) {
+      painter->fillRect(rect, QColor::fromRgba(obj->highlightFill()));
+    }
+  }
+}
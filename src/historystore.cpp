@@ -0,0 +1,148 @@
+﻿#include "../headers/historystore.h"
+#include <QDebug>
+#include <QDir>
+#include <QtConcurrent/QtConcurrent>
+
+std::atomic<qint64> HistoryStore::total{0};
+std::atomic<qint64> HistoryStore::tabBudget{DEFAULT_HISTORY_TAB_MB * 1024LL *
+                                            1024LL};
+std::atomic<qint64> HistoryStore::totalBudget{DEFAULT_HISTORY_MB * 1024LL *
+                                              1024LL};
+
+HistoryStore::HistoryStore()
+    : file{QDir::tempPath() + "/tfi-history-XXXXXX"} {}
+
+HistoryStore::~HistoryStore() {
+  wait();
+  total -= held;
+}
+
+void HistoryStore::setBudget(int tabMegabytes, int totalMegabytes) {
+  tabBudget = tabMegabytes * 1024LL * 1024LL;
+  totalBudget = totalMegabytes * 1024LL * 1024LL;
+}
+
+qint64 HistoryStore::totalBytes() { return total; }
+
+// Steps further than HISTORY_RAW_STEPS are compressed, then the furthest
+// compressed ones go to disk until both budgets are met. done is called on
+// the worker thread.
+void HistoryStore::compact(const QVector<QVector<Patch> *> &entries,
+                           const std::function<void()> &done) {
+  wait();
+  pending = QtConcurrent::run([this, entries, done]() {
+    const int raw = entries.size() - HISTORY_RAW_STEPS;
+    for (auto i = 0; i < raw; i++) {
+      for (auto &patch : *entries[i]) {
+        pack(patch);
+      }
+    }
+
+    qint64 bytes = 0;
+    for (const auto &patches : entries) {
+      for (const auto &patch : *patches) {
+        bytes += size(patch);
+      }
+    }
+    total += bytes - held.exchange(bytes);
+
+    for (auto i = 0; i < raw; i++) {
+      for (auto &patch : *entries[i]) {
+        if (held <= tabBudget && total <= totalBudget) {
+          break;
+        }
+        const qint64 freed = size(patch);
+        if (spill(patch)) {
+          held -= freed;
+          total -= freed;
+        }
+      }
+    }
+
+    if (done) {
+      done();
+    }
+  });
+}
+
+// brings spilled and compressed patches back as pixels, which count against
+// the budgets again until the next compact()
+void HistoryStore::load(QVector<Patch> &patches) {
+  wait();
+  for (auto &patch : patches) {
+    const qint64 before = size(patch);
+    if (patch.offset >= 0 && file.seek(patch.offset)) {
+      patch.packed = file.read(patch.length);
+      spilled -= patch.length;
+      patch.offset = -1;
+    }
+    unpack(patch);
+    const qint64 grown = size(patch) - before;
+    held += grown;
+    total += grown;
+  }
+}
+
+void HistoryStore::release(QVector<Patch> &patches) {
+  wait();
+  for (const auto &patch : patches) {
+    if (patch.offset >= 0) {
+      spilled -= patch.length;
+    }
+    held -= size(patch);
+    total -= size(patch);
+  }
+  patches.clear();
+}
+
+void HistoryStore::wait() { pending.waitForFinished(); }
+
+qint64 HistoryStore::bytes() const { return held; }
+
+qint64 HistoryStore::spilledBytes() const { return spilled; }
+
+qint64 HistoryStore::size(const Patch &patch) {
+  return patch.pixels.total() * patch.pixels.elemSize() + patch.packed.size();
+}
+
+// zlib at its fastest level, screenshots and scans of text shrink well
+void HistoryStore::pack(Patch &patch) {
+  if (patch.pixels.empty()) {
+    return;
+  }
+  const cv::Mat pixels =
+      patch.pixels.isContinuous() ? patch.pixels : patch.pixels.clone();
+  patch.type = pixels.type();
+  const auto length = static_cast<int>(pixels.total() * pixels.elemSize());
+  patch.packed = qCompress(pixels.data, length, HISTORY_COMPRESSION);
+  patch.pixels = cv::Mat{};
+}
+
+void HistoryStore::unpack(Patch &patch) {
+  if (patch.packed.isEmpty()) {
+    return;
+  }
+  QByteArray raw = qUncompress(patch.packed);
+  patch.pixels = cv::Mat{patch.region.height, patch.region.width, patch.type,
+                         raw.data()}
+                     .clone();
+  patch.packed = QByteArray{};
+}
+
+// appends to the spill file, space is reclaimed when the tab closes
+bool HistoryStore::spill(Patch &patch) {
+  if (patch.packed.isEmpty() || (!file.isOpen() && !file.open())) {
+    return false;
+  }
+  const qint64 offset = file.size();
+  if (!file.seek(offset) ||
+      file.write(patch.packed) != patch.packed.size()) {
+    qDebug() << "Failed to spill undo history to" << file.fileName();
+    return false;
+  }
+  patch.offset = offset;
+  patch.length = patch.packed.size();
+  patch.packed = QByteArray{};
+  spilled += patch.length;
+  return true;
+}
@@ -0,0 +1,53 @@
+﻿#include "../headers/imagebuffer.h"
+#include <QPainter>
+
+QAtomicInt ImageBuffer::copied{0};
+
+ImageBuffer::ImageBuffer(const cv::Mat &matrix) : cv::Mat{matrix} {}
+
+// Converts straight into a freshly allocated buffer, whatever the source
+// format, instead of swapping and cloning through intermediate images.
+ImageBuffer ImageBuffer::fromImage(const QImage &image) {
+  if (image.isNull()) {
+    return ImageBuffer{};
+  }
+
+  ImageBuffer buffer{cv::Mat{image.height(), image.width(), CV_8UC3}};
+  QImage target = buffer.view();
+  QPainter painter{&target};
+  painter.setCompositionMode(QPainter::CompositionMode_Source);
+  painter.drawImage(0, 0, image);
+  painter.end();
+
+  copied.ref();
+  return buffer;
+}
+
+int ImageBuffer::copies() { return copied.loadRelaxed(); }
+
+// QImage over the same pixels, valid as long as this buffer is not
+// reassigned
+QImage ImageBuffer::view() {
+  return QImage{data, cols, rows, static_cast<int>(step),
+                QImage::Format_BGR888};
+}
+
+// null until a quantization of these pixels has been handed over
+const ColorIndex *ImageBuffer::colors() const {
+  return hasColors() ? index.data() : nullptr;
+}
+
+bool ImageBuffer::hasColors() const {
+  return index && index->size() == size();
+}
+
+void ImageBuffer::setColors(const QSharedPointer<ColorIndex> &colors) {
+  index = colors;
+}
+
+// relabels the pixels written inside region
+void ImageBuffer::recolor(const cv::Rect &region) {
+  if (hasColors()) {
+    index->update(*this, region);
+  }
+}
@@ -1,7 +1,15 @@
 ﻿#include "../headers/imageframe.h"
+#include "../headers/enginepool.h"
+#include "../headers/ocrcache.h"
+#include "../headers/ocrmonitor.h"
+#include "../headers/ocrscheduler.h"
+#include "../headers/preprocess.h"
 #include "../headers/tabscroll.h"
+#include "../headers/timing.h"
 #include "headers/imagetextobject.h"
 #include "qlistwidget.h"
+#include "tesseract/ocrclass.h"
+#include <algorithm>
 
 ImageFrame::ImageFrame(QWidget *parent, QWidget *__tab, Ui::MainWindow *__ui,
                        Options *__options)
@@ -9,9 +17,12 @@ ImageFrame::ImageFrame(QWidget *parent, QWidget *__tab, Ui::MainWindow *__ui,
       disableMove(false), stagedState{nullptr}, scalar{1.0},
       scaleIncrement{0.1}, tab{__tab}, rubberBand{nullptr},
       scene{new QGraphicsScene(this)}, options{__options}, ui{__ui},
-      spinner{nullptr}, dropper{false}, middleDown{false}, zoomChanged{false},
-      state{new State} {
+      spinner{nullptr}, dropper{false}, middleDown{false}, state{new State},
+      generation{0}, copyMark{0}, colorGeneration{0}, colorQueued{false},
+      fillGeneration{0}, overlay{new HighlightLayer}, pressed{nullptr} {
 
+  scene->addItem(overlay);
+  overlay->setObjects(&state->textObjects);
   qApp->installEventFilter(this);
   initUi(parent);
   setWidgets();
@@ -20,6 +31,17 @@ ImageFrame::ImageFrame(QWidget *parent, QWidget *__tab, Ui::MainWindow *__ui,
 }
 
 ImageFrame::~ImageFrame() {
+  if (isProcessing) {
+    monitor->cancel();
+    OcrScheduler::instance().withdraw(this);
+    job.waitForFinished();
+  }
+  ++colorGeneration;
+  colorJob.waitForFinished();
+  for (auto &fillJob : fillJobs) {
+    fillJob.waitForFinished();
+  }
+  history.wait();
   ui->listWidget->clear();
 
   for (const auto &obj : state->textObjects) {
@@ -36,137 +58,292 @@ ImageFrame::~ImageFrame() {
   delete rubberBand;
 }
 
-cv::Mat ImageFrame::getImageMatrix() { return state->matrix; }
+cv::Mat ImageFrame::getImageMatrix() { return matrix; }
+
+// area touched by filling or drawing an object, with room for the inpaint
+// border around it
+static cv::Rect editedRegion(const ImageTextObject *obj) {
+  const int border = 4;
+  return cv::Rect{
+      cv::Point{obj->topLeft.x() - border, obj->topLeft.y() - border},
+      cv::Point{obj->bottomRight.x() + border, obj->bottomRight.y() + border}};
+}
+
+void ImageFrame::pasteImage(QImage *img) {
+  cancel();
 
-static inline cv::Mat QImageToCvMat(const QImage &inImage,
-                                    bool inCloneImageData = true) {
-  switch (inImage.format()) {
-  // 8-bit, 4 channel
-  case QImage::Format_ARGB32:
-  case QImage::Format_ARGB32_Premultiplied: {
-    cv::Mat mat(inImage.height(), inImage.width(), CV_8UC4,
-                const_cast<uchar *>(inImage.bits()),
-                static_cast<size_t>(inImage.bytesPerLine()));
-    return (inCloneImageData ? mat.clone() : mat);
+  for (const auto &obj : state->textObjects) {
+    obj->hide();
+    obj->setDisabled(true);
   }
 
-    // 8-bit, 3 channel
-  case QImage::Format_RGB32: {
-    if (!inCloneImageData) {
-      qWarning() << "ASM::QImageToCvMat() - Conversion requires cloning so we "
-                    "don't modify the original QImage data";
-    }
+  // the pasted image replaces the buffer rather than writing into it, so the
+  // undo state can keep the old pixels as one whole frame patch without a copy
+  State *oldState = new State{state->textObjects, selection};
+  oldState->patches.push_back(
+      Patch{cv::Rect{0, 0, matrix.cols, matrix.rows}, matrix});
+  oldState->patches.last().wholeFrame = true;
+  undo.push(oldState); // scene dims
+  dropRedo();
+  state->textObjects.erase(state->textObjects.begin(),
+                           state->textObjects.end());
 
-    cv::Mat mat(inImage.height(), inImage.width(), CV_8UC4,
-                const_cast<uchar *>(inImage.bits()),
-                static_cast<size_t>(inImage.bytesPerLine()));
+  scalar = 1.0;
+  auto mat = ImageBuffer::fromImage(*img);
+  selection = nullptr;
 
-    cv::Mat matNoAlpha;
+  extract(&mat);
+  changeImage();
+  populateTextObjects();
+  compactHistory();
+}
 
-    cv::cvtColor(mat, matNoAlpha,
-                 cv::COLOR_BGRA2BGR); // drop the all-white alpha channel
-    return matNoAlpha;
+// The frame keeps the size of the whole zoomed image so the scroll area and
+// highlights behave as before, but only tiles near the visible part are
+// rendered into the scene.
+void ImageFrame::changeImage() {
+  if (matrix.empty()) {
+    return;
   }
 
-    // 8-bit, 3 channel
-  case QImage::Format_RGB888: {
-    if (!inCloneImageData) {
-      qWarning() << "ASM::QImageToCvMat() - Conversion requires cloning so we "
-                    "don't modify the original QImage data";
-    }
+  const QSize size{cvRound(matrix.cols * scalar),
+                   cvRound(matrix.rows * scalar)};
+
+  qDeleteAll(tiles);
+  tiles.clear();
+  scene->setSceneRect(QRect{QPoint{0, 0}, size});
+  this->setScene(scene);
 
-    QImage swapped = inImage.rgbSwapped();
-    return cv::Mat(swapped.height(), swapped.width(), CV_8UC3,
-                   const_cast<uchar *>(swapped.bits()),
-                   static_cast<size_t>(swapped.bytesPerLine()))
-        .clone();
+  overlay->setBounds(QSize{matrix.cols, matrix.rows});
+  overlay->setScale(scalar);
+
+  this->setMinimumSize(size);
+  this->setMaximumSize(size);
+  renderViewport();
+}
+
+// Renders the tiles within VIEW_PREFETCH of the scroll area's viewport and
+// drops those that scrolled further away, so memory is bounded by the screen
+// rather than by the image size times the zoom squared.
+void ImageFrame::renderViewport() {
+  if (matrix.empty()) {
+    return;
   }
 
-    // 8-bit, 1 channel
-  case QImage::Format_Indexed8: {
-    cv::Mat mat(inImage.height(), inImage.width(), CV_8UC1,
-                const_cast<uchar *>(inImage.bits()),
-                static_cast<size_t>(inImage.bytesPerLine()));
-    return (inCloneImageData ? mat.clone() : mat);
+  const QRect bounds = scene->sceneRect().toRect();
+  QRect view = bounds;
+  if (auto tabScroll = qobject_cast<TabScroll *>(tab)) {
+    auto sa = tabScroll->getScrollArea();
+    QPoint offset{sa->horizontalScrollBar()->value(),
+                  sa->verticalScrollBar()->value()};
+    view = QRect{offset - this->pos(), sa->viewport()->size()};
+  }
+
+  const QRect keep =
+      view.adjusted(-2 * VIEW_PREFETCH, -2 * VIEW_PREFETCH, 2 * VIEW_PREFETCH,
+                    2 * VIEW_PREFETCH);
+  for (auto it = tiles.begin(); it != tiles.end();) {
+    const QRect rect{it.value()->pos().toPoint(),
+                     it.value()->pixmap().size()};
+    if (!keep.intersects(rect)) {
+      delete it.value();
+      it = tiles.erase(it);
+    } else {
+      ++it;
+    }
   }
 
-  default:
-    qWarning() << "ASM::QImageToCvMat() - QImage format not handled in switch:"
-               << inImage.format();
-    break;
+  const QRect wanted = view.adjusted(-VIEW_PREFETCH, -VIEW_PREFETCH,
+                                     VIEW_PREFETCH, VIEW_PREFETCH) &
+                       bounds;
+  if (wanted.isEmpty()) {
+    return;
   }
 
-  return cv::Mat();
+  for (auto ty = wanted.top() / VIEW_TILE_SIZE;
+       ty <= wanted.bottom() / VIEW_TILE_SIZE; ty++) {
+    for (auto tx = wanted.left() / VIEW_TILE_SIZE;
+         tx <= wanted.right() / VIEW_TILE_SIZE; tx++) {
+      if (tiles.contains({tx, ty})) {
+        continue;
+      }
+
+      const QRect rect =
+          QRect{tx * VIEW_TILE_SIZE, ty * VIEW_TILE_SIZE, VIEW_TILE_SIZE,
+                VIEW_TILE_SIZE} &
+          bounds;
+      cv::Mat tile;
+      try {
+        tile = pyramid.render(
+            matrix, scalar,
+            cv::Rect{rect.x(), rect.y(), rect.width(), rect.height()});
+      } catch (cv::Exception &e) {
+        qDebug() << e.what() << "In renderViewport:";
+        return;
+      }
+
+      QImage image{tile.data, tile.cols, tile.rows, (int)tile.step,
+                   QImage::Format_BGR888};
+      auto item = scene->addPixmap(QPixmap::fromImage(image));
+      item->setPos(rect.topLeft());
+      tiles[{tx, ty}] = item;
+    }
+  }
 }
 
-void ImageFrame::pasteImage(QImage *img) {
-  if (isProcessing) {
+// Brings the screen up to date after the matrix changed inside region. Only
+// the pyramid levels and scene tiles overlapping it are redrawn, so editing a
+// word costs about as much as the word.
+void ImageFrame::refreshRegion(const cv::Rect &region) {
+  const cv::Rect bounds{0, 0, matrix.cols, matrix.rows};
+  const cv::Rect changed = region & bounds;
+  const QSize size{cvRound(matrix.cols * scalar),
+                   cvRound(matrix.rows * scalar)};
+  matrix.recolor(changed);
+
+  if (changed == bounds || size != scene->sceneRect().size().toSize()) {
+    pyramid.clear();
+    changeImage();
     return;
   }
 
-  for (const auto &obj : state->textObjects) {
-    obj->hide();
-    obj->setDisabled(true);
+  pyramid.replace(matrix, changed);
+  if (changed.empty()) {
+    return;
   }
 
-  State *oldState = new State{state->textObjects, cv::Mat{}, selection};
-
-  state->matrix.copyTo(oldState->matrix);
-  undo.push(oldState); // scene dims
-  redo = QStack<State *>{};
-  state->textObjects.erase(state->textObjects.begin(),
-                           state->textObjects.end());
-
-  scalar = 1.0;
-  auto imagePixmap = QPixmap::fromImage(*img);
+  // scaled, with a pixel of slack for the filter footprint
+  const QRect dirty{QPoint{cvFloor(changed.x * scalar) - 1,
+                           cvFloor(changed.y * scalar) - 1},
+                    QPoint{cvCeil(changed.br().x * scalar) + 1,
+                           cvCeil(changed.br().y * scalar) + 1}};
 
-  scene->addPixmap(imagePixmap);
-  scene->setSceneRect(imagePixmap.rect());
-  scene->update();
-  this->setScene(scene);
+  for (const auto &item : tiles) {
+    const QRect rect{item->pos().toPoint(), item->pixmap().size()};
+    const QRect part = rect & dirty;
+    if (part.isEmpty()) {
+      continue;
+    }
 
-  this->setMinimumSize(imagePixmap.size());
-  this->setMaximumSize(imagePixmap.size());
-  auto mat = QImageToCvMat(*img);
-  selection = nullptr;
+    cv::Mat patch;
+    try {
+      patch = pyramid.render(
+          matrix, scalar,
+          cv::Rect{part.x(), part.y(), part.width(), part.height()});
+    } catch (cv::Exception &e) {
+      qDebug() << e.what() << "In refreshRegion:";
+      return;
+    }
 
-  extract(&mat);
-  populateTextObjects();
+    QPixmap pixmap = item->pixmap();
+    QPainter painter{&pixmap};
+    painter.drawImage(part.topLeft() - rect.topLeft(),
+                      QImage{patch.data, patch.cols, patch.rows,
+                             static_cast<int>(patch.step),
+                             QImage::Format_BGR888});
+    painter.end();
+    item->setPixmap(pixmap);
+  }
 }
 
-void ImageFrame::changeImage(QImage *img) {
-  if (state->matrix.empty()) {
+// Keeps the pixels inside region as they are now in target, which must happen
+// before they are written. An edit saves each area it touches.
+void ImageFrame::savePixels(State *target, const cv::Rect &region) {
+  const cv::Rect r = region & cv::Rect{0, 0, matrix.cols, matrix.rows};
+  if (r.empty()) {
     return;
   }
+  target->patches.push_back(Patch{r, matrix(r).clone()});
+  preserveSnapshots(r);
+}
 
-  try {
-    display = cv::Mat{};
-    state->matrix.copyTo(display);
-    cv::resize(display, display, {}, scalar, scalar, cv::INTER_AREA);
-  } catch (cv::Exception &e) {
-    qDebug() << e.what() << "In changeImage:";
-    delete scene;
-    scene = new QGraphicsScene(this);
-    return;
+// a running recognition or color prefetch keeps reading the pixels from
+// before the edit
+void ImageFrame::preserveSnapshots(const cv::Rect &region) {
+  if (isProcessing && reading) {
+    reading->preserve(region);
+  }
+  if (sampling) {
+    sampling->preserve(region);
   }
+}
+
+// Writes the patches of target back for undo and redo, newest first, and
+// saves the pixels they cover into the state being left so the step can be
+// reversed. Returns the area that changed.
+cv::Rect ImageFrame::swapPixels(State *target) {
+  ++fillGeneration;
+  history.load(target->patches);
+  auto patches = std::move(target->patches);
+  target->patches.clear();
+
+  // a pasted image is swapped whole
+  if (patches.size() == 1 && patches.first().wholeFrame) {
+    state->patches.push_back(
+        Patch{cv::Rect{0, 0, matrix.cols, matrix.rows}, matrix});
+    state->patches.last().wholeFrame = true;
+    matrix = patches.first().pixels;
+    return cv::Rect{0, 0, INT_MAX, INT_MAX};
+  }
+
+  cv::Rect dirty;
+  for (const auto &patch : patches) {
+    savePixels(state, patch.region);
+    dirty |= patch.region;
+  }
+  for (auto it = patches.crbegin(); it != patches.crend(); ++it) {
+    it->pixels.copyTo(matrix(it->region));
+  }
+  return dirty;
+}
 
-  if (!img) {
-    img = new QImage{(uchar *)display.data, display.cols, display.rows,
-                     (int)display.step, QImage::Format_BGR888};
+// Hands the history to the store, furthest steps first, once an edit or an
+// undo is done with it. Steps near the current state stay as they are.
+void ImageFrame::compactHistory() {
+  QVector<QVector<Patch> *> entries;
+  for (auto i = qMax(undo.size(), redo.size()); i > 0; i--) {
+    if (i <= undo.size()) {
+      entries.push_back(&undo.at(undo.size() - i)->patches);
+    }
+    if (i <= redo.size()) {
+      entries.push_back(&redo.at(redo.size() - i)->patches);
+    }
   }
 
-  auto imagePixmap = QPixmap::fromImage(*img);
+  history.compact(entries, [this]() {
+    QMetaObject::invokeMethod(
+        this, [this]() { showHistory(); }, Qt::QueuedConnection);
+  });
+}
 
-  delete scene;
-  scene = new QGraphicsScene(this);
-  scene->addPixmap(imagePixmap);
-  scene->setSceneRect(imagePixmap.rect());
-  scene->update();
-  this->setScene(scene);
+// steps that can no longer be redone give up their pixels
+void ImageFrame::dropRedo() {
+  for (const auto &state : redo) {
+    history.release(state->patches);
+  }
+  redo = QStack<State *>{};
+}
+
+void ImageFrame::showHistory() {
+  const auto message =
+      QString{"Undo history: %1 MB in memory, %2 MB on disk"}
+          .arg(history.bytes() / (1024.0 * 1024.0), 0, 'f', 1)
+          .arg(history.spilledBytes() / (1024.0 * 1024.0), 0, 'f', 1);
+  qCDebug(lcTiming) << message << "of"
+                    << HistoryStore::totalBytes() / (1024 * 1024)
+                    << "MB in all tabs";
+
+  if (!isProcessing && tab) {
+    ui->tab->setTabToolTip(ui->tab->indexOf(tab), message);
+  }
+}
 
-  this->setMinimumSize(imagePixmap.size());
-  this->setMaximumSize(imagePixmap.size());
-  delete img;
+static size_t patchBytes(const ImageFrame::State *state) {
+  size_t bytes = 0;
+  for (const auto &patch : state->patches) {
+    bytes += patch.pixels.total() * patch.pixels.elemSize();
+  }
+  return bytes;
 }
 
 void ImageFrame::changeText() {
@@ -177,11 +354,11 @@ void ImageFrame::changeText() {
     qDebug() << "No selection";
     return;
   }
-  const cv::Scalar colorSelection = selection->fontIntensity;
+  const cv::Scalar colorSelection = selection->getFontColor();
   QColor color{
-      static_cast<int>(selection->fontIntensity[2]),
-      static_cast<int>(selection->fontIntensity[1]),
-      static_cast<int>(selection->fontIntensity[0]),
+      static_cast<int>(colorSelection[2]),
+      static_cast<int>(colorSelection[1]),
+      static_cast<int>(colorSelection[0]),
   };
 
   QVector<ImageTextObject *> oldObjs = state->textObjects;
@@ -189,36 +366,17 @@ void ImageFrame::changeText() {
   selection->hide();
   selection->setDisabled(true);
   auto *oldSelection = selection;
-  selection =
-      new ImageTextObject{this, *selection, ui, &state->matrix, options};
+  selection = new ImageTextObject{overlay, *selection, &matrix, options};
   state->selection = selection;
   selection->setHighlightColor(GREEN_HIGHLIGHT);
   selection->isPersistent = true;
-  connectSelection(selection);
 
   state->textObjects.push_back(selection);
-  State *oldState = new State{oldObjs, cv::Mat{}, oldSelection};
-  state->matrix.copyTo(oldState->matrix);
-  undo.push(oldState);
-  redo = QStack<State *>{};
+  overlay->reindex();
 
-  selection->fillBackground();
-
-  QImage *img;
-  if (!zoomChanged) {
-    state->matrix.copyTo(display);
-    img = new QImage{(uchar *)display.data, display.cols, display.rows,
-                     (int)display.step, QImage::Format_BGR888};
-  } else {
-    img = new QImage{(uchar *)state->matrix.data, state->matrix.cols,
-                     state->matrix.rows, (int)state->matrix.step,
-                     QImage::Format_BGR888};
-  }
-  QPainter p;
-  if (!p.begin(img)) {
-    qDebug() << "error with painter";
-    return;
-  }
+  // text is painted straight into the matrix, only what was touched is
+  // saved for undo and refreshed on screen afterwards
+  QImage img = matrix.view();
 
   auto fontSizeStr = ui->fontSizeInput->text();
   if (fontSizeStr.isEmpty() || fontSizeStr.toInt() == 0) {
@@ -237,10 +395,9 @@ void ImageFrame::changeText() {
     ui->letterSpacing->setText(spacing);
   }
   font.setLetterSpacing(QFont::AbsoluteSpacing, spacing.toInt());
-  p.setFont(font);
 
   /* take max horizontal length */
-  QFontMetrics fm{p.font()};
+  QFontMetrics fm{font, &img};
   auto j = 0, k = 0, max = 0;
   while ((j = label.indexOf("\n", j)) != -1) {
     auto sub = label.mid(k, j - k);
@@ -256,8 +413,8 @@ void ImageFrame::changeText() {
   QPoint wh{selection->topLeft.x() + (int)x, selection->topLeft.y() + (int)y};
   QRect oldRect{selection->topLeft, selection->bottomRight};
 
-  // Scale back to normal size before resizing
-  selection->scaleAndPosition(1);
+  selection->lineSpace = QPair<QPoint, QPoint>{selection->topLeft,
+                                               selection->bottomRight};
   selection->topLeft.setY(selection->topLeft.y());
   selection->bottomRight = wh;
   QRect rect{selection->topLeft, selection->bottomRight};
@@ -266,8 +423,39 @@ void ImageFrame::changeText() {
   double newHeight =
       (label.count("\n") + 1) * rect.height() * 1.0 / oldRect.height();
   selection->scaleAndPosition(newWidth, newHeight);
-  // Scale to current size
-  selection->scaleAndPosition(scalar);
+
+  // the old box and the new lines, with a line of slack for overhanging
+  // glyphs. Painting is clipped to it so the saved pixels cover the edit.
+  const int lines = label.count("\n") + 1;
+  const QRect text = QRect{selection->topLeft,
+                           QSize{max, lines * rect.height()}}
+                         .adjusted(-fm.height(), -fm.height(), fm.height(),
+                                   fm.height());
+  const cv::Rect dirty =
+      (editedRegion(oldSelection) | editedRegion(selection) |
+       cv::Rect{text.x(), text.y(), text.width(), text.height()}) &
+      cv::Rect{0, 0, matrix.cols, matrix.rows};
+
+  // a move being staged collects the pixels of both of its ends
+  State *oldState = stagedState;
+  if (!oldState) {
+    copyMark = ImageBuffer::copies();
+    oldState = new State{oldObjs, oldSelection};
+    undo.push(oldState);
+    dropRedo();
+  }
+  savePixels(oldState, dirty);
+
+  selection->fillBackground();
+  refineFill(selection);
+
+  QPainter p;
+  if (!p.begin(&img)) {
+    qDebug() << "error with painter";
+    return;
+  }
+  p.setFont(font);
+  p.setClipRect(QRect{dirty.x, dirty.y, dirty.width, dirty.height});
 
   p.save();
   p.setPen(color);
@@ -299,16 +487,19 @@ void ImageFrame::changeText() {
   p.restore();
   p.end();
 
-  auto swap = img->convertToFormat(QImage::Format_RGB888);
-  state->matrix = QImageToCvMat(swap);
   selection->isPersistent = true;
   selection->showHighlight();
-  selection->mat = &state->matrix;
-  selection->fontIntensity = colorSelection;
-  delete img;
+  selection->mat = &matrix;
 
   renderListView();
-  changeImage();
+  refreshRegion(dirty);
+
+  if (oldState != stagedState) {
+    qCDebug(lcTiming) << "Edit made" << ImageBuffer::copies() - copyMark
+                      << "full frame copies and kept"
+                      << patchBytes(oldState) / 1024 << "KB of undo pixels";
+    compactHistory();
+  }
 }
 
 void ImageFrame::connections() {
@@ -320,6 +511,7 @@ void ImageFrame::connections() {
               textObjects.push_back(objectFromItemsMap[item]);
             }
             state->textObjects = textObjects;
+            overlay->reindex();
           });
 
   connect(ui->listWidget, &QListWidget::itemPressed, this,
@@ -346,24 +538,19 @@ void ImageFrame::connections() {
             contextMenu.exec(mapToGlobal(pos));
           });
 
+  if (auto tabScroll = qobject_cast<TabScroll *>(tab)) {
+    auto sa = tabScroll->getScrollArea();
+    for (const auto &bar :
+         {sa->horizontalScrollBar(), sa->verticalScrollBar()}) {
+      connect(bar, &QScrollBar::valueChanged, this,
+              &ImageFrame::renderViewport);
+      connect(bar, &QScrollBar::rangeChanged, this,
+              &ImageFrame::renderViewport);
+    }
+  }
   connect(spinner, &QMovie::frameChanged, this, [&] {
     ui->tab->setTabIcon(ui->tab->indexOf(tab), QIcon{spinner->currentPixmap()});
   });
-  connect(this, &ImageFrame::processing, this, [&] {
-    isProcessing = !isProcessing;
-
-    if (!this->isEnabled())
-      return;
-
-    if (!isProcessing) {
-      populateTextObjects();
-      spinner->stop();
-      ui->tab->setTabIcon(ui->tab->indexOf(tab), QIcon{});
-      ui->tab->setCurrentWidget(tab);
-    } else {
-      spinner->start();
-    }
-  });
   connect(ui->dropper, &QPushButton::pressed, this, [&] {
     this->setCursor(Qt::CursorShape::CrossCursor);
     if (!hideAll)
@@ -385,6 +572,12 @@ void ImageFrame::connections() {
           &ImageFrame::changeZoom);
   connect(ui->find, &QLineEdit::editingFinished, this,
           &ImageFrame::findSubstrings);
+  connect(&colorWatcher, &QFutureWatcher<void>::finished, this, [&] {
+    if (colorQueued) {
+      colorQueued = false;
+      prefetchColors();
+    }
+  });
 }
 
 void ImageFrame::removeSelection() {
@@ -461,6 +654,8 @@ void ImageFrame::initUi(QWidget *parent) {
   this->setParent(parent);
   this->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
   this->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+  // hovering a highlight shows the pointing hand
+  this->viewport()->setMouseTracking(true);
   this->hide();
 }
 
@@ -468,7 +663,6 @@ void ImageFrame::changeZoom() {
   if (!this->isEnabled())
     return;
 
-  zoomChanged = true;
   double val = (ui->zoomFactor->text()).toDouble();
   if (val == 0) {
     val = scalar;
@@ -481,16 +675,12 @@ void ImageFrame::changeZoom() {
   ui->zoomFactor->setText("");
   ui->zoomFactor->setPlaceholderText(QString::number(100 * scalar) + "%");
   changeImage();
-  for (auto &obj : state->textObjects) {
-    obj->scaleAndPosition(scalar);
-  }
 }
 
 void ImageFrame::zoomIn() {
   if (!this->isEnabled())
     return;
 
-  zoomChanged = true;
   auto sa =
       qobject_cast<TabScroll *>(ui->tab->currentWidget())->getScrollArea();
   auto hb = sa->horizontalScrollBar();
@@ -504,9 +694,6 @@ void ImageFrame::zoomIn() {
   ui->zoomFactor->setText("");
   ui->zoomFactor->setPlaceholderText(QString::number(100 * scalar) + "%");
   changeImage();
-  for (const auto &obj : state->textObjects) {
-    obj->scaleAndPosition(scalar);
-  }
 
   hb->setValue(prevH + hb->maximum());
   vb->setValue(prevV + vb->maximum());
@@ -516,7 +703,6 @@ void ImageFrame::zoomOut() {
   if (!this->isEnabled())
     return;
 
-  zoomChanged = true;
   auto sa =
       qobject_cast<TabScroll *>(ui->tab->currentWidget())->getScrollArea();
   auto hb = sa->horizontalScrollBar();
@@ -530,9 +716,6 @@ void ImageFrame::zoomOut() {
   ui->zoomFactor->setText("");
   ui->zoomFactor->setPlaceholderText(QString::number(100 * scalar) + "%");
   changeImage();
-  for (const auto &obj : state->textObjects) {
-    obj->scaleAndPosition(scalar);
-  }
 
   hb->setValue(prevH + hb->maximum());
   vb->setValue(prevV + vb->maximum());
@@ -544,12 +727,17 @@ void ImageFrame::mousePressEvent(QMouseEvent *event) {
   }
 
   if (dropper) {
-    auto point = event->pos();
-    auto color = display.at<cv::Vec3b>(cv::Point{point.x(), point.y()});
+    auto point = event->pos() / scalar;
+    point.setX(qBound(0, point.x(), matrix.cols - 1));
+    point.setY(qBound(0, point.y(), matrix.rows - 1));
+    auto color = matrix.at<cv::Vec3b>(cv::Point{point.x(), point.y()});
 
     this->setCursor(Qt::CursorShape::ArrowCursor);
     hideHighlights();
     emit colorSelected(color);
+  } else if ((pressed = overlay->objectAt(event->pos() / scalar))) {
+    pressed->drag = true;
+    return;
   }
 
   if (!keysPressed[Qt::Key_Control] && !dropper) {
@@ -564,6 +752,7 @@ void ImageFrame::mousePressEvent(QMouseEvent *event) {
       obj->deselect();
       if (!obj->isPersistent) {
         obj->hide();
+        itemListMap[obj]->setSelected(false);
       }
     }
   }
@@ -593,15 +782,15 @@ bool ImageFrame::eventFilter(QObject *obj, QEvent *event) {
 
   if (dropper && event->type() == QEvent::MouseMove) {
     QMouseEvent *mouseEvent = static_cast<QMouseEvent *>(event);
-    auto pos = mouseEvent->pos();
-    if (pos.x() < 0 || pos.x() >= display.cols) {
+    auto pos = mouseEvent->pos() / scalar;
+    if (pos.x() < 0 || pos.x() >= matrix.cols) {
       return false;
     }
-    if (pos.y() < 0 || pos.y() >= display.rows) {
+    if (pos.y() < 0 || pos.y() >= matrix.rows) {
       return false;
     }
 
-    auto color = display.at<cv::Vec3b>(cv::Point{pos.x(), pos.y()});
+    auto color = matrix.at<cv::Vec3b>(cv::Point{pos.x(), pos.y()});
 
     QString style = ImageTextObject::formatStyle(color);
     ui->colorSelect->setStyleSheet(style);
@@ -613,10 +802,74 @@ bool ImageFrame::eventFilter(QObject *obj, QEvent *event) {
 void ImageFrame::mouseMoveEvent(QMouseEvent *event) {
   auto pos = event->pos();
 
-  rubberBand->setGeometry(QRect{origin, pos}.normalized());
+  if (pressed) {
+    dragSelection(pos / scalar);
+    return;
+  }
+
+  if (!event->buttons()) {
+    if (!dropper) {
+      const bool over = overlay->objectAt(pos / scalar);
+      this->viewport()->setCursor(over ? Qt::CursorShape::PointingHandCursor
+                                       : Qt::CursorShape::ArrowCursor);
+    }
+    return;
+  }
+
+  if (rubberBand) {
+    rubberBand->setGeometry(QRect{origin, pos}.normalized());
+  }
+}
+
+// follows the cursor with the selection while its highlight is held down
+void ImageFrame::dragSelection(const QPoint &pos) {
+  if (!selection) {
+    return;
+  }
+
+  if (selection->drag) {
+    move(pos, true);
+  }
+
+  if (pos.y() >= matrix.rows || pos.x() >= matrix.cols) {
+    selection->drag = false;
+  } else if (pos.y() < 0 || pos.x() < 0) {
+    selection->drag = false;
+  }
+}
+
+// Letting go of a highlight. Releasing the one already selected stages it
+// where it was dragged to, and a release over the highlight counts as a
+// click on it.
+void ImageFrame::releaseObject(ImageTextObject *obj, const QPoint &pos) {
+  obj->drag = false;
+
+  if (selection) {
+    selection->setHighlightColor(YELLOW_HIGHLIGHT);
+    selection->deselect();
+
+    auto prev = selection;
+    selection = obj;
+
+    if (prev == selection) {
+      move(QPoint{0, 0}, false);
+      stageState(true);
+    }
+  }
+
+  if (obj->rect().contains(pos)) {
+    activate(obj);
+  }
 }
 
 void ImageFrame::mouseReleaseEvent(QMouseEvent *event) {
+  if (pressed) {
+    auto obj = pressed;
+    pressed = nullptr;
+    releaseObject(obj, event->pos() / scalar);
+    return;
+  }
+
   if (state->textObjects.isEmpty() || !this->isEnabled())
     return;
   if (dropper) {
@@ -647,44 +900,30 @@ void ImageFrame::mouseReleaseEvent(QMouseEvent *event) {
   inliers(box);
 }
 
+// Selects what the rubber band touched. Only the grid cells under the band
+// are looked at, so the cost follows the selection rather than the page.
 void ImageFrame::inliers(QPair<QPoint, QPoint> boundingBox) {
-  auto a = boundingBox.first;
-  auto b = boundingBox.second;
+  QElapsedTimer timer;
+  timer.start();
 
-  for (const auto &obj : state->textObjects) {
-    if (!obj->isEnabled()) {
-      continue;
-    }
-    auto tl = obj->topLeft;
-    auto br = obj->bottomRight;
-
-    bool xOverlap = !((br.x() < a.x()) || (tl.x() > b.x()));
-    bool yOverlap = !((br.y() < a.y()) || (tl.y() > b.y()));
-
-    if (xOverlap && yOverlap) {
-      obj->selectHighlight();
-      itemListMap[obj]->setSelected(true);
-    } else if (!obj->isSelected && !obj->isPersistent) {
-      itemListMap[obj]->setSelected(false);
-    }
+  const auto found =
+      overlay->objectsIn(QRect{boundingBox.first, boundingBox.second});
+  for (const auto &obj : found) {
+    obj->selectHighlight();
+    itemListMap[obj]->setSelected(true);
   }
+
+  qCDebug(lcTiming) << "Selected" << found.size() << "of"
+                    << state->textObjects.size() << "boxes in"
+                    << timer.nsecsElapsed() / 1000 << "us";
 }
 
 void ImageFrame::setImage(QString imageName) {
   filepath = imageName;
   scalar = 1.0;
 
-  QPixmap imagePixmap{imageName};
-
-  scene->addPixmap(imagePixmap);
-  scene->setSceneRect(imagePixmap.rect());
-  scene->update();
-  this->setScene(scene);
-
-  this->setMinimumSize(imagePixmap.size());
-  this->setMaximumSize(imagePixmap.size());
-
   extract();
+  changeImage();
   populateTextObjects();
 }
 
@@ -696,10 +935,10 @@ void ImageFrame::showAll() {
 
 void ImageFrame::extract(cv::Mat *mat) {
   if (mat) {
-    mat->copyTo(state->matrix);
+    matrix = *mat;
   } else {
     try {
-      state->matrix =
+      matrix =
           cv::Mat{cv::imread(filepath.toStdString(), cv::IMREAD_COLOR)};
     } catch (...) {
       qDebug() << "error reading image";
@@ -707,155 +946,682 @@ void ImageFrame::extract(cv::Mat *mat) {
     }
   }
 
-  if (state->matrix.empty()) {
+  if (matrix.empty()) {
     qDebug() << "empty mat";
     return;
   }
 
-  QFuture<void> future = QtConcurrent::run(
-      [&](cv::Mat matrix) -> void {
-        emit processing();
+  const OcrConfig config = options->getConfig();
+  const int id = ++generation;
+  layout = LayoutTree{};
+  ++colorGeneration;
+  ++fillGeneration;
+  sampling.reset();
+
+  // everything coming back from the worker is queued onto the GUI thread and
+  // dropped if the job has been cancelled or replaced in the meantime
+  monitor.reset(new OcrMonitor);
+  monitor->progressed = [this, id](int percent) {
+    QMetaObject::invokeMethod(
+        this,
+        [this, id, percent] {
+          if (id == generation) {
+            showProgress(percent);
+          }
+        },
+        Qt::QueuedConnection);
+  };
+  monitor->recognized = [this, id, config](const LayoutTree &piece) {
+    const auto boxes = piece.boxes(config.RIL);
+    QMetaObject::invokeMethod(
+        this,
+        [this, id, boxes] {
+          if (id == generation) {
+            streamTextObjects(boxes);
+          }
+        },
+        Qt::QueuedConnection);
+  };
+
+  isProcessing = true;
+  spinner->start();
+
+  // edits made while the job runs copy the tiles they touch out of its way
+  // instead of the whole frame
+  reading.reset(new TiledImage{matrix});
+  const QSharedPointer<TiledImage> snapshot = reading;
+  const QSharedPointer<OcrMonitor> jobMonitor = monitor;
+  const qint64 bytes =
+      static_cast<qint64>(matrix.total()) * OCR_BYTES_PER_PIXEL;
+
+  job = OcrScheduler::instance().submit(
+      this, bytes, [this, id, config, snapshot, jobMonitor] {
+        if (jobMonitor->isCancelled()) {
+          return;
+        }
 
-        rawText = collect(matrix);
-        state->matrix.copyTo(display);
+        LayoutTree result;
+        QString text = collect(*snapshot, config, result, jobMonitor.data());
 
-        emit processing();
-      },
-      state->matrix);
+        QMetaObject::invokeMethod(
+            this,
+            [this, id, text, result, config] {
+              if (id == generation) {
+                finishExtraction(text, result, config.RIL);
+              }
+            },
+            Qt::QueuedConnection);
+      });
+  showQueue();
 
   showAll();
 }
 
-cv::Scalar ImageFrame::defaultColor;
+// the tooltip stays until the job reports progress
+void ImageFrame::showQueue() {
+  const auto stats = OcrScheduler::instance().stats();
+  const auto message =
+      QString{"Queued: %1 waiting, %2 running, %3 done, average wait %4 ms"}
+          .arg(stats.queued)
+          .arg(stats.running)
+          .arg(stats.finished)
+          .arg(stats.finished ? stats.waitMs / stats.finished : 0);
+  ui->tab->setTabToolTip(ui->tab->indexOf(tab), message);
+}
 
-void ImageFrame::connectSelection(ImageTextObject *obj) {
-  QObject::connect(obj, &ImageTextObject::selection, this, [&]() {
-    if (isDrag) {
-      isDrag = false;
-      return;
-    }
+// Stops a running extraction and waits for its worker. Boxes streamed so far
+// stay on the page.
+void ImageFrame::cancel() {
+  if (!isProcessing) {
+    return;
+  }
 
-    selection = qobject_cast<ImageTextObject *>(sender());
-    for (const auto &tempObj : state->textObjects) {
-      if (tempObj == selection) {
-        continue;
-      }
-      tempObj->setHighlightColor(YELLOW_HIGHLIGHT);
-      tempObj->deselect();
-    }
+  monitor->cancel();
+  OcrScheduler::instance().withdraw(this);
+  job.waitForFinished();
+  ++generation;
 
-    QString style = ImageTextObject::formatStyle(selection->fontIntensity);
-    ui->colorSelect->setStyleSheet(style);
-  });
+  isProcessing = false;
+  reading.reset();
+  stopSpinner();
+}
 
-  Highlight *hb = obj->highlightButton;
-  auto release = [&] {
-    if (!selection) {
-      return;
+void ImageFrame::stopSpinner() {
+  spinner->stop();
+  ui->tab->setTabIcon(ui->tab->indexOf(tab), QIcon{});
+  ui->tab->setTabToolTip(ui->tab->indexOf(tab), QString{});
+  if (this->isEnabled()) {
+    ui->statusbar->clearMessage();
+  }
+}
+
+void ImageFrame::showProgress(int percent) {
+  auto message = QString{"Recognizing... %1%"}.arg(percent);
+  ui->tab->setTabToolTip(ui->tab->indexOf(tab), message);
+  if (this->isEnabled()) {
+    ui->statusbar->showMessage(message);
+  }
+}
+
+void ImageFrame::finishExtraction(const QString &text, const LayoutTree &result,
+                                  tesseract::PageIteratorLevel RIL) {
+  rawText = text;
+  layout = result;
+  isProcessing = false;
+  stopSpinner();
+
+  if (reading && reading->preserved()) {
+    qCDebug(lcTiming) << "Edits during recognition copied"
+                      << reading->preserved() << "tiles";
+  }
+  reading.reset();
+
+  // bands stream in whichever order they finish, put the highlights back in
+  // reading order. Each object is ranked once, boxes with the same corners
+  // take their layout indices in turn.
+  typedef QPair<QPair<int, int>, QPair<int, int>> Corners;
+  const auto corners = [](const QPoint &topLeft, const QPoint &bottomRight) {
+    return Corners{{topLeft.x(), topLeft.y()},
+                   {bottomRight.x(), bottomRight.y()}};
+  };
+
+  QHash<Corners, QVector<int>> indices;
+  const auto boxes = layout.boxes(RIL);
+  for (auto i = boxes.size() - 1; i >= 0; i--) {
+    indices[corners(boxes[i].topLeft, boxes[i].bottomRight)].push_back(i);
+  }
+
+  QHash<const ImageTextObject *, int> rank;
+  rank.reserve(state->textObjects.size());
+  for (const auto &obj : state->textObjects) {
+    auto it = indices.find(corners(obj->topLeft, obj->bottomRight));
+    if (it == indices.end() || it->isEmpty()) {
+      rank[obj] = boxes.size();
+    } else {
+      rank[obj] = it->takeLast();
     }
+  }
+  std::stable_sort(state->textObjects.begin(), state->textObjects.end(),
+                   [&rank](const ImageTextObject *a, const ImageTextObject *b) {
+                     return rank.value(a) < rank.value(b);
+                   });
+  overlay->reindex();
 
-    selection->setHighlightColor(YELLOW_HIGHLIGHT);
-    selection->deselect();
+  // the level was changed in options while this job was running
+  if (RIL != options->getRIL()) {
+    setGranularity(options->getRIL());
+  } else {
+    prefetchColors();
+  }
 
-    auto prev = selection;
-    selection = qobject_cast<ImageTextObject *>(sender()->parent()->parent());
+  if (!this->isEnabled())
+    return;
 
-    if (!selection->drag && prev == selection) {
-      move(QPoint{0, 0}, false);
-      stageState(true);
+  renderListView();
+  ui->tab->setCurrentWidget(tab);
+}
+
+// Adds the highlights for a newly recognized piece of the page while the rest
+// is still being worked on.
+void ImageFrame::streamTextObjects(const QVector<OcrBox> &boxes) {
+  const int from = state->textObjects.size();
+  addTextObjects(boxes);
+  populateTextObjects(from);
+}
+
+cv::Scalar ImageFrame::defaultColor;
+
+// What clicking a highlight does. A persistent one becomes the selection
+// and loads its text into the editing controls.
+void ImageFrame::activate(ImageTextObject *obj) {
+  if (!obj->isPersistent) {
+    return;
+  }
+
+  ui->fontSizeInput->setText(QString::number(obj->fontSize));
+  ui->textEdit->setText(obj->getText());
+  obj->paintHighlight(GREEN_HIGHLIGHT);
+
+  QString style = ImageTextObject::formatStyle(obj->getFontColor());
+  ui->colorSelect->setStyleSheet(style);
+
+  // the click that ended a move
+  if (isDrag) {
+    isDrag = false;
+    return;
+  }
+
+  selection = obj;
+  for (const auto &tempObj : state->textObjects) {
+    if (tempObj == selection) {
+      continue;
     }
-  };
+    tempObj->setHighlightColor(YELLOW_HIGHLIGHT);
+    tempObj->deselect();
+  }
+}
 
-  auto shift = [&](const QPoint &pos) {
-    if (!selection) {
-      return;
+ImageFrame::State *&ImageFrame::getState() { return state; }
+
+void ImageFrame::addTextObjects(const QVector<OcrBox> &boxes) {
+  for (const auto &box : boxes) {
+    ImageTextObject *textObject = new ImageTextObject;
+
+    textObject->setText(box.text);
+    textObject->lineSpace = QPair<QPoint, QPoint>{box.topLeft, box.bottomRight};
+    textObject->topLeft = box.topLeft;
+    textObject->bottomRight = box.bottomRight;
+    state->textObjects.push_back(textObject);
+  }
+}
+
+// Rebuilds the highlights at another level from the captured layout, so
+// switching between words, lines and paragraphs needs no recognition.
+void ImageFrame::setGranularity(tesseract::PageIteratorLevel RIL) {
+  if (isProcessing || layout.isEmpty()) {
+    return;
+  }
+
+  for (const auto &obj : state->textObjects) {
+    obj->hide();
+    obj->setDisabled(true);
+  }
+
+  // pixels are left alone
+  State *oldState = new State{state->textObjects, selection};
+  undo.push(oldState);
+  dropRedo();
+  state->textObjects.clear();
+  selection = nullptr;
+
+  addTextObjects(layout.boxes(RIL));
+  populateTextObjects();
+  compactHistory();
+  prefetchColors();
+}
+
+// Reads the colors of every box on the worker threads once a page is
+// recognized, so selecting or editing one doesn't stop to analyse it. The
+// image is quantized there the first time, and whatever was edited meanwhile
+// is relabeled before the index is kept. Boxes that were analysed, moved or
+// removed in the meantime are left alone, and a new image or a new pass
+// cancels the quantization between strips.
+void ImageFrame::prefetchColors() {
+  typedef QPair<ImageTextObject *, cv::Rect> Box;
+
+  QVector<Box> boxes;
+  for (const auto &obj : state->textObjects) {
+    if (!obj->isAnalysed()) {
+      boxes.push_back(Box{obj, cv::Rect{cv::Point{obj->topLeft.x(),
+                                                  obj->topLeft.y()},
+                                        cv::Point{obj->bottomRight.x(),
+                                                  obj->bottomRight.y()}}});
     }
+  }
+  if (boxes.isEmpty() || matrix.empty() || matrix.type() != CV_8UC3) {
+    return;
+  }
 
-    auto relPos = QWidget::mapFromGlobal(pos) / scalar;
-    if (selection->drag) {
-      move(relPos, true);
+  // with the labels at hand each box is one pass over its bytes
+  if (matrix.hasColors()) {
+    for (const auto &box : boxes) {
+      box.first->setColors(matrix.colors()->analyse(box.second));
     }
+    return;
+  }
 
-    if (relPos.y() >= display.rows || relPos.x() >= display.cols) {
-      selection->drag = false;
-    } else if (relPos.y() < 0 || relPos.x() < 0) {
-      selection->drag = false;
+  // a quantization already running is never waited for, this pass starts
+  // once it is done and will find its labels
+  if (colorJob.isRunning()) {
+    colorQueued = true;
+    return;
+  }
+
+  const int id = ++colorGeneration;
+  sampling.reset(new TiledImage{matrix});
+  const QSharedPointer<TiledImage> snapshot = sampling;
+
+  colorJob = QtConcurrent::run([this, id, boxes, snapshot] {
+    QElapsedTimer timer;
+    timer.start();
+
+    const QSharedPointer<ColorIndex> index{new ColorIndex{
+        *snapshot, [this, id] { return id != colorGeneration; }}};
+    if (id != colorGeneration) {
+      return;
     }
-  };
+    qCDebug(lcTiming) << "Quantized colors in" << timer.elapsed() << "ms";
+
+    const std::function<ColorStats(const Box &)> analyse =
+        [this, id, index](const Box &box) {
+          if (id != colorGeneration) {
+            return ColorStats{};
+          }
+          return index->analyse(box.second);
+        };
+    const auto stats =
+        QtConcurrent::blockingMapped<QVector<ColorStats>>(boxes, analyse);
+
+    qCDebug(lcTiming) << "Analysed colors of" << boxes.size() << "boxes in"
+                      << timer.elapsed() << "ms";
+
+    QMetaObject::invokeMethod(
+        this,
+        [this, id, boxes, stats, index] {
+          if (id != colorGeneration) {
+            return;
+          }
+          if (!matrix.hasColors()) {
+            for (const auto &region : sampling->preservedRegions()) {
+              index->update(matrix, region);
+            }
+            matrix.setColors(index);
+          }
+          sampling.reset();
+
+          QHash<ImageTextObject *, int> order;
+          for (auto i = 0; i < boxes.size(); i++) {
+            order[boxes[i].first] = i;
+          }
+          for (const auto &obj : state->textObjects) {
+            const auto it = order.constFind(obj);
+            if (it == order.constEnd() || obj->isAnalysed()) {
+              continue;
+            }
+            const Box &box = boxes[it.value()];
+            if (box.second.tl() == cv::Point{obj->topLeft.x(),
+                                             obj->topLeft.y()} &&
+                box.second.br() == cv::Point{obj->bottomRight.x(),
+                                             obj->bottomRight.y()}) {
+              obj->setColors(stats[it.value()]);
+            }
+          }
+        },
+        Qt::QueuedConnection);
+  });
+  colorWatcher.setFuture(colorJob);
+}
 
-  QObject::connect(hb, &Highlight::drag, this, shift);
-  QObject::connect(hb, &Highlight::released, this, release);
+// Runs the fill the object still owes on a worker thread. The quick fill
+// stays on screen until then, and is dropped with the job if an undo or a
+// new image puts other pixels there first.
+void ImageFrame::refineFill(ImageTextObject *obj) {
+  const auto request = obj->takeFill();
+  if (!request) {
+    return;
+  }
+
+  fillJobs.erase(std::remove_if(fillJobs.begin(), fillJobs.end(),
+                                [](const QFuture<void> &job) {
+                                  return job.isFinished();
+                                }),
+                 fillJobs.end());
+
+  const int id = fillGeneration;
+  fillJobs.push_back(QtConcurrent::run([this, id, request] {
+    // a paragraph is worked on in tiles across the cores
+    cv::Mat refined = request->source.clone();
+    fillHoles(refined,
+              {FillHole{cv::Rect{cv::Point{0, 0}, refined.size()},
+                        request->mask}},
+              request->method);
+    QMetaObject::invokeMethod(
+        this,
+        [this, id, request, refined] {
+          if (id == fillGeneration) {
+            applyFill(*request, refined);
+          }
+        },
+        Qt::QueuedConnection);
+  }));
 }
 
-ImageFrame::State *&ImageFrame::getState() { return state; }
+// Only pixels of the hole that still hold the quick fill are replaced, text
+// painted or moved over it since stays where it is.
+void ImageFrame::applyFill(const FillRequest &request, const cv::Mat &refined) {
+  if ((request.region & cv::Rect{0, 0, matrix.cols, matrix.rows}) !=
+      request.region) {
+    return;
+  }
 
-void ImageFrame::populateTextObjects() {
-  QVector<ImageTextObject *> tempObjects;
+  cv::Mat area = matrix(request.region), diff, unchanged;
+  cv::absdiff(area, request.fast, diff);
+  cv::inRange(diff, cv::Scalar::all(0), cv::Scalar::all(0), unchanged);
+  unchanged &= request.mask;
+  if (!cv::countNonZero(unchanged)) {
+    return;
+  }
 
-  for (const auto &obj : state->textObjects) {
+  preserveSnapshots(request.region);
+  refined.copyTo(area, unchanged);
+  refreshRegion(request.region);
+}
+
+void ImageFrame::populateTextObjects(int from) {
+  for (auto i = from; i < state->textObjects.size(); i++) {
+    ImageTextObject *obj = state->textObjects[i];
     ImageTextObject *temp =
-        new ImageTextObject{this, std::move(*obj), ui, &state->matrix, options};
+        new ImageTextObject{overlay, std::move(*obj), &matrix, options};
     temp->hide();
-    tempObjects.push_back(temp);
-    connectSelection(temp);
+    delete obj;
+    state->textObjects[i] = temp;
   }
+  overlay->reindex();
 
-  state->textObjects = tempObjects;
+  if (!this->isEnabled()) {
+    return;
+  }
   renderListView();
   removeSelection();
 }
 
-QString ImageFrame::collect(const cv::Mat &matrix) {
-  tesseract::TessBaseAPI *api = new tesseract::TessBaseAPI();
+typedef struct Band {
+  cv::Rect region;
+  int coreTop, coreBottom;
+} Band;
+
+// Cuts the page into full-width bands roughly tileSize tall. Each cut is
+// snapped to the emptiest row near the target so lines are rarely split, and
+// every band is padded by overlap on both sides of its core rows.
+static QVector<Band> splitBands(const TiledImage &image, int tileSize,
+                                int overlap) {
+  cv::Mat gray{image.rows(), image.cols(), CV_8UC1}, ink, profile;
+  for (auto y = 0; y < image.rows(); y += IMAGE_TILE_SIZE) {
+    const cv::Rect strip{0, y, image.cols(),
+                         qMin(IMAGE_TILE_SIZE, image.rows() - y)};
+    cv::Mat part = gray(strip);
+    cv::cvtColor(image.read(strip), part, cv::COLOR_BGR2GRAY);
+  }
+  cv::threshold(gray, ink, 0, 1, cv::THRESH_BINARY_INV | cv::THRESH_OTSU);
+  if (static_cast<size_t>(cv::countNonZero(ink)) > ink.total() / 2) {
+    ink = 1 - ink;
+  }
+  cv::reduce(ink, profile, 1, cv::REDUCE_SUM, CV_32S);
+
+  QVector<int> cuts{0};
+  while (cuts.last() + tileSize < image.rows() - overlap) {
+    int target = cuts.last() + tileSize;
+    int lo = qMax(cuts.last() + overlap + 1, target - overlap);
+    int hi = qMin(image.rows() - overlap - 1, target + overlap);
+
+    int cut = target;
+    for (auto y = lo; y <= hi; y++) {
+      if (profile.at<int>(y) < profile.at<int>(cut)) {
+        cut = y;
+      }
+    }
+    cuts.push_back(cut);
+  }
+  cuts.push_back(image.rows());
+
+  QVector<Band> bands;
+  for (auto i = 1; i < cuts.size(); i++) {
+    int top = qMax(0, cuts[i - 1] - overlap);
+    int bottom = qMin(image.rows(), cuts[i] + overlap);
+    bands.push_back(Band{cv::Rect{0, top, image.cols(), bottom - top},
+                         cuts[i - 1], cuts[i]});
+  }
+
+  return bands;
+}
 
-  const auto RIL = options->getRIL();
-  const auto OEM = options->getOEM();
-  const auto PSM = options->getPSM();
-  auto data = options->getDataFile().toLocal8Bit();
+// Links Tesseract's monitor back to the job: progress is polled and
+// cancellation checked every time Tesseract finishes a word.
+typedef struct Watch {
+  tesseract::ETEXT_DESC desc;
+  OcrMonitor *monitor;
+  int region, done, total;
+} Watch;
+
+static bool watchRecognition(void *cancel_this, int) {
+  auto watch = static_cast<Watch *>(cancel_this);
+  watch->monitor->update(watch->region,
+                         (watch->done * 100 + watch->desc.progress) /
+                             watch->total);
+  return watch->monitor->isCancelled();
+}
 
-  api->Init(nullptr, data.data(), OEM);
-  api->SetPageSegMode(PSM);
-  api->SetImage(matrix.data, matrix.cols, matrix.rows, 3, matrix.step);
-  api->Recognize(0);
+// Text blocks found by layout analysis alone, in reading order
+static QVector<cv::Rect> analyseBlocks(tesseract::TessBaseAPI *api) {
+  QVector<cv::Rect> blocks;
+  tesseract::PageIterator *pi = api->AnalyseLayout();
+  if (!pi) {
+    return blocks;
+  }
 
-  QString text = QString{api->GetUTF8Text()};
-  tesseract::ResultIterator *ri = api->GetIterator();
   int x1, y1, x2, y2;
+  do {
+    if (tesseract::PTIsTextType(pi->BlockType()) &&
+        pi->BoundingBox(tesseract::RIL_BLOCK, &x1, &y1, &x2, &y2)) {
+      blocks.push_back(cv::Rect{x1, y1, x2 - x1, y2 - y1});
+    }
+  } while (pi->Next(tesseract::RIL_BLOCK));
 
-  if (ri != 0) {
-    do {
-      QString string = ri->GetUTF8Text(RIL);
-      if (string.trimmed() == "") {
-        continue;
+  delete pi;
+  return blocks;
+}
+
+// The automatic segmentation modes recognize the page one block at a time,
+// so a streaming monitor can show the first boxes long before the whole
+// region is done. Batch runs split the same way, which keeps its layout and
+// the cached one identical to the GUI's. The other modes describe the whole
+// region.
+static QString recognizeRegion(const TiledImage &source, const Band &band,
+                               int index, const OcrConfig &config,
+                               LayoutTree &layout, OcrMonitor *monitor) {
+  tesseract::TessBaseAPI *api =
+      EnginePool::instance().acquire(config.dataFile, config.OEM);
+  if (!api) {
+    return "";
+  }
+
+  const cv::Rect &region = band.region;
+  const cv::Mat roi = source.read(region);
+  Prepared prepared{roi, 1.0, 0, 0};
+  if (config.preprocess) {
+    prepared = preprocess(roi, config);
+  }
+
+  const cv::Mat &image = prepared.image;
+  api->SetPageSegMode(config.PSM);
+  api->SetImage(image.data, image.cols, image.rows, image.channels(),
+                image.step);
+  if (prepared.dpi) {
+    api->SetSourceResolution(prepared.dpi);
+  }
+
+  QVector<cv::Rect> blocks;
+  if (config.PSM == tesseract::PSM_AUTO ||
+      config.PSM == tesseract::PSM_AUTO_OSD) {
+    blocks = analyseBlocks(api);
+  }
+
+  const bool split = blocks.size() > 1;
+  if (split) {
+    api->SetPageSegMode(tesseract::PSM_SINGLE_BLOCK);
+  } else {
+    blocks = {cv::Rect{0, 0, image.cols, image.rows}};
+  }
+
+  Watch watch;
+  watch.monitor = monitor;
+  watch.region = index;
+  watch.total = blocks.size();
+  watch.desc.cancel = watchRecognition;
+  watch.desc.cancel_this = &watch;
+
+  QString text;
+  for (auto i = 0; i < blocks.size(); i++) {
+    if (monitor && monitor->isCancelled()) {
+      break;
+    }
+
+    if (split) {
+      const auto &block = blocks[i];
+      api->SetRectangle(block.x, block.y, block.width, block.height);
+    }
+    watch.done = i;
+    api->Recognize(monitor ? &watch.desc : nullptr);
+    if (monitor && monitor->isCancelled()) {
+      break;
+    }
+
+    char *utf8 = api->GetUTF8Text();
+    text += QString{utf8};
+    delete[] utf8;
+
+    tesseract::ResultIterator *ri = api->GetIterator();
+    if (ri != 0) {
+      LayoutTree piece, kept;
+      piece.capture(ri, QSize{image.cols, image.rows});
+      piece.transform(prepared.scale, prepared.padding,
+                      QPoint{region.x, region.y}, QSize{roi.cols, roi.rows});
+      kept.append(piece, band.coreTop, band.coreBottom);
+      layout.append(kept, band.coreTop, band.coreBottom);
+      delete ri;
+
+      if (monitor) {
+        monitor->publish(kept);
       }
-      ri->BoundingBox(RIL, &x1, &y1, &x2, &y2);
+    }
+  }
 
-      x1 = x1 < 0 ? 0 : x1;
-      x1 = x1 > matrix.cols ? matrix.cols - 1 : x1;
-      x2 = x2 < 0 ? 0 : x2;
-      x2 = x2 > matrix.cols ? matrix.cols - 1 : x2;
+  if (monitor) {
+    monitor->update(index, 100);
+  }
 
-      y1 = y1 < 0 ? 0 : y1;
-      y1 = y1 > matrix.rows ? matrix.rows - 1 : y1;
-      y2 = y2 < 0 ? 0 : y2;
-      y2 = y2 > matrix.rows ? matrix.rows - 1 : y2;
+  EnginePool::instance().release(api);
+  return text;
+}
 
-      QPoint p1{x1, y1}, p2{x2, y2};
-      ImageTextObject *textObject = new ImageTextObject{nullptr};
+// Shared by the GUI and --batch so both produce the same boxes
+QString ImageFrame::collect(const TiledImage &image, const OcrConfig &config,
+                            LayoutTree &layout, OcrMonitor *monitor) {
+  QString text;
+  QByteArray key;
+
+  if (config.cache) {
+    key = OcrCache::key(image, config);
+    if (OcrCache::instance().lookup(key, text, layout)) {
+      if (monitor) {
+        monitor->publish(layout);
+      }
+      return text;
+    }
+  }
 
-      textObject->setText(string);
-      textObject->lineSpace = QPair<QPoint, QPoint>{p1, p2};
-      textObject->topLeft = p1;
-      textObject->bottomRight = p2;
-      state->textObjects.push_back(textObject);
-    } while (ri->Next(RIL));
+  text = recognize(image, config, layout, monitor);
+  if (monitor && monitor->isCancelled()) {
+    return text;
+  }
+  if (config.cache && (!text.isEmpty() || !layout.isEmpty())) {
+    OcrCache::instance().store(key, text, layout);
   }
 
-  api->End();
-  delete api;
   return text;
 }
 
+QString ImageFrame::recognize(const TiledImage &image, const OcrConfig &config,
+                              LayoutTree &layout, OcrMonitor *monitor) {
+  const auto tileSize = config.tileSize;
+  const auto overlap = config.tileOverlap;
+
+  if (!config.tiled || image.rows() <= tileSize + overlap) {
+    if (monitor) {
+      monitor->begin(1);
+    }
+    const Band page{cv::Rect{0, 0, image.cols(), image.rows()}, 0,
+                    image.rows()};
+    return recognizeRegion(image, page, 0, config, layout, monitor);
+  }
+
+  QElapsedTimer timer;
+  timer.start();
+
+  const auto bands = splitBands(image, tileSize, overlap);
+  if (monitor) {
+    monitor->begin(bands.size());
+  }
+
+  // bands share the scheduler's workers, so they never add threads beyond
+  // its job limit
+  QVector<LayoutTree> results(bands.size());
+  OcrScheduler::instance().parallel(bands.size(), [&](int i) {
+    recognizeRegion(image, bands[i], i, config, results[i], monitor);
+  });
+
+  // a node belongs to the band whose core rows contain its center, which
+  // drops the duplicate recognized in the neighbouring band's overlap
+  for (auto i = 0; i < bands.size(); i++) {
+    layout.append(results[i], bands[i].coreTop, bands[i].coreBottom);
+  }
+
+  qCDebug(lcTiming) << "Tiled recognition:" << bands.size() << "bands took"
+                    << timer.elapsed() << "ms";
+
+  return layout.text();
+}
+
 void ImageFrame::undoAction() {
   if (undo.empty() || isProcessing || !tab) {
     return;
@@ -871,31 +1637,31 @@ void ImageFrame::undoAction() {
     obj->setDisabled(true);
   }
 
+  const cv::Rect changed = swapPixels(undo.top());
   redo.push(state);
   state = undo.pop();
+  overlay->setObjects(&state->textObjects);
 
   for (const auto &obj : state->textObjects) {
-    obj->scaleAndPosition(scalar);
     obj->setDisabled(false);
 
     if (obj->isPersistent) {
       obj->show();
     }
-    obj->mat = &state->matrix;
   }
 
   if ((selection = state->selection)) {
     selection->setHighlightColor(GREEN_HIGHLIGHT);
     selection->showHighlight();
-    selection->mat = &state->matrix;
 
     ui->textEdit->setText(selection->getText());
     ui->fontSizeInput->setText(QString::number(selection->fontSize));
-    emit selection->highlightButton->clicked();
+    activate(selection);
   }
 
   renderListView();
-  changeImage();
+  refreshRegion(changed);
+  compactHistory();
 }
 
 void ImageFrame::redoAction() {
@@ -912,27 +1678,27 @@ void ImageFrame::redoAction() {
     obj->setDisabled(true);
   }
 
+  const cv::Rect changed = swapPixels(redo.top());
   undo.push(state);
   state = redo.pop();
+  overlay->setObjects(&state->textObjects);
 
   for (const auto &obj : state->textObjects) {
-    obj->scaleAndPosition(scalar);
     obj->setDisabled(false);
     if (obj->isPersistent) {
       obj->show();
     }
-    obj->mat = &state->matrix;
   }
 
   if ((selection = state->selection)) {
     selection->setHighlightColor(GREEN_HIGHLIGHT);
     selection->showHighlight();
-    selection->mat = &state->matrix;
-    emit selection->highlightButton->clicked();
+    activate(selection);
   }
 
   renderListView();
-  changeImage();
+  refreshRegion(changed);
+  compactHistory();
 }
 
 void ImageFrame::groupSelections() {
@@ -947,15 +1713,15 @@ void ImageFrame::groupSelections() {
   QPoint newTL{-1, -1}, newBR{-1, -1};
 
   QVector<ImageTextObject *> oldObjs = state->textObjects;
-  State *oldState = new State{oldObjs, cv::Mat{}, selection};
-  state->matrix.copyTo(oldState->matrix);
+  // pixels are left alone
+  State *oldState = new State{oldObjs, selection};
   undo.push(oldState);
-  redo = QStack<State *>{};
+  dropRedo();
 
-  ImageTextObject *textObject = new ImageTextObject{nullptr};
+  ImageTextObject *textObject = new ImageTextObject;
   QVector<ImageTextObject *> newTextObjects;
 
-  int start = -1;
+  int start = -1, prevLine = -1;
   for (auto i = 0; i < state->textObjects.size(); i++) {
     auto &obj = state->textObjects[i];
 
@@ -963,6 +1729,16 @@ void ImageFrame::groupSelections() {
       if (start == -1)
         start = i;
 
+      // break the group where the selection crosses a recognized text line
+      auto center = (obj->topLeft + obj->bottomRight) / 2;
+      int line = layout.find(center, tesseract::RIL_TEXTLINE);
+      if (line != -1 && prevLine != -1 && line != prevLine &&
+          contiguousStr.endsWith(' ')) {
+        contiguousStr.chop(1);
+        contiguousStr += '\n';
+      }
+      prevLine = line;
+
       if (newTL == QPoint{-1, -1})
         newTL = obj->topLeft;
       if (newBR == QPoint{-1, -1})
@@ -996,10 +1772,9 @@ void ImageFrame::groupSelections() {
   textObject->bottomRight = newBR;
 
   textObject =
-      new ImageTextObject{this, *textObject, ui, &state->matrix, options};
+      new ImageTextObject{overlay, *textObject, &matrix, options};
   textObject->reset();
   textObject->selectHighlight();
-  textObject->scaleAndPosition(scalar);
   /* selection = textObject; */
 
   // reindex after grouping
@@ -1015,15 +1790,19 @@ void ImageFrame::groupSelections() {
   }
 
   state->textObjects = final;
-  connectSelection(textObject);
+  overlay->reindex();
 
   renderListView();
+  compactHistory();
 }
 
 void ImageFrame::renderListView() {
+  ui->listWidget->setUpdatesEnabled(false);
   ui->listWidget->clear();
   itemListMap.clear();
   objectFromItemsMap.clear();
+  itemListMap.reserve(state->textObjects.size());
+  objectFromItemsMap.reserve(state->textObjects.size());
   for (const auto &obj : state->textObjects) {
     ui->listWidget->addItem(obj->getText());
     const auto currItem = ui->listWidget->item(ui->listWidget->count() - 1);
@@ -1031,6 +1810,77 @@ void ImageFrame::renderListView() {
     itemListMap[obj] = currItem;
     currItem->setSelected(obj->isSelected || obj->isPersistent);
   }
+  ui->listWidget->setUpdatesEnabled(true);
+}
+
+// Takes the text of every selected object out of the image in one step and
+// drops the objects. Inpainting goes through fillHoles(), which packs the
+// small boxes into shared passes and spreads them over the cores.
+void ImageFrame::eraseSelections() {
+  if (!this->isEnabled() || !tab) {
+    return;
+  }
+  if (stagedState) {
+    stageState();
+  }
+
+  QElapsedTimer timer;
+  timer.start();
+  copyMark = ImageBuffer::copies();
+  QVector<ImageTextObject *> erased;
+  for (const auto &obj : state->textObjects) {
+    if (obj->isSelected || obj == selection) {
+      erased.push_back(obj);
+    }
+  }
+  if (erased.isEmpty()) {
+    qDebug() << "No selection";
+    return;
+  }
+
+  QVector<ImageTextObject *> oldObjs = state->textObjects;
+  State *oldState = new State{oldObjs, selection};
+  undo.push(oldState);
+  dropRedo();
+
+  // everything is read before anything is written, so no box sees the
+  // fill of its neighbour
+  const auto method = options->getFillMethod();
+  QVector<FillHole> holes;
+  cv::Rect dirty;
+  for (const auto &obj : erased) {
+    const cv::Rect region = editedRegion(obj);
+    savePixels(oldState, region);
+    dirty |= region;
+
+    obj->getBackgroundColor();
+    if (method != Options::NEIGHBOR) {
+      holes.push_back(obj->textHole());
+    }
+  }
+
+  for (const auto &obj : erased) {
+    obj->reset();
+    if (method == Options::NEIGHBOR) {
+      obj->fillBackground();
+    }
+    state->textObjects.removeOne(obj);
+  }
+  fillHoles(matrix, holes, method);
+
+  if (erased.contains(selection)) {
+    selection = nullptr;
+  }
+  overlay->reindex();
+  renderListView();
+  refreshRegion(dirty);
+
+  qCDebug(lcTiming) << "Erased" << erased.size() << "objects in"
+                    << timer.elapsed() << "ms, made"
+                    << ImageBuffer::copies() - copyMark
+                    << "full frame copies and kept"
+                    << patchBytes(oldState) / 1024 << "KB of undo pixels";
+  compactHistory();
 }
 
 void ImageFrame::deleteSelection() {
@@ -1045,14 +1895,16 @@ void ImageFrame::deleteSelection() {
   auto idx = state->textObjects.indexOf(selection);
   selection->reset();
   QVector<ImageTextObject *> oldObjs = state->textObjects;
-  State *oldState = new State{oldObjs, cv::Mat{}, selection};
-  state->matrix.copyTo(oldState->matrix);
+  // pixels are left alone
+  State *oldState = new State{oldObjs, selection};
   undo.push(oldState);
-  redo = QStack<State *>{};
+  dropRedo();
 
   state->textObjects.remove(idx);
+  overlay->reindex();
   renderListView();
   selection = nullptr;
+  compactHistory();
 }
 
 void ImageFrame::keyReleaseEvent(QKeyEvent *event) {
@@ -1063,21 +1915,29 @@ void ImageFrame::keyReleaseEvent(QKeyEvent *event) {
 }
 
 void ImageFrame::stageState(bool drag) {
+  const cv::Rect dirty =
+      editedRegion(stagedState->selection) | editedRegion(selection);
+  savePixels(stagedState, editedRegion(selection));
+
   if (options->getFillMethod() == Options::NEIGHBOR) {
     stagedState->selection->fillBackground();
   }
   undo.push(stagedState);
-  redo = QStack<State *>{};
-  stagedState = nullptr;
+  dropRedo();
   selection->unstageMove();
   isDrag = drag;
 
   if (options->getFillMethod() == Options::NEIGHBOR) {
     changeText();
-    undo.pop();
   }
-  changeImage();
+  stagedState = nullptr;
+  refreshRegion(dirty);
   renderListView();
+
+  qCDebug(lcTiming) << "Move made" << ImageBuffer::copies() - copyMark
+                    << "full frame copies and kept"
+                    << patchBytes(undo.top()) / 1024 << "KB of undo pixels";
+  compactHistory();
 }
 
 void ImageFrame::configureDragSelection() {
@@ -1085,20 +1945,16 @@ void ImageFrame::configureDragSelection() {
   selection->setDisabled(true);
   state->textObjects.remove(state->textObjects.indexOf(selection));
 
-  auto colors = selection->colorPalette;
-  auto fontIntensity = selection->fontIntensity;
-  selection = new ImageTextObject{this, std::move(*selection), ui,
-                                  &state->matrix, options};
-  selection->colorPalette = colors;
-  selection->fontIntensity = fontIntensity;
+  selection = new ImageTextObject{overlay, std::move(*selection),
+                                  &matrix, options};
 
   selection->setHighlightColor(GREEN_HIGHLIGHT);
   selection->isPersistent = true;
   selection->drag = false;
   selection->showHighlight();
-  connectSelection(selection);
   state->textObjects.push_back(selection);
   state->selection = selection;
+  overlay->reindex();
 }
 
 void ImageFrame::move(QPoint shift, bool drag) {
@@ -1114,8 +1970,10 @@ void ImageFrame::move(QPoint shift, bool drag) {
   if (!stagedState) {
     before = selection->topLeft;
     QVector<ImageTextObject *> oldObjs = state->textObjects;
-    State *oldState = new State{oldObjs, cv::Mat{}, selection};
-    state->matrix.copyTo(oldState->matrix);
+    copyMark = ImageBuffer::copies();
+    State *oldState = new State{oldObjs, selection};
+    // the text is lifted out of here on the first step
+    savePixels(oldState, editedRegion(selection));
     stagedState = oldState;
   }
 
@@ -1124,19 +1982,17 @@ void ImageFrame::move(QPoint shift, bool drag) {
   }
 
   if (shift == QPoint{0, 0}) {
-    stagedState->selection->scaleAndPosition(scalar);
     stagedState->selection->reposition(before - selection->topLeft);
-    selection->scaleAndPosition(scalar);
+    refineFill(stagedState->selection);
     return;
   }
 
   if (drag) {
     selection->reposition(shift, false);
-    selection->scaleAndPosition(scalar);
   } else {
     selection->reposition(shift);
-    selection->scaleAndPosition(scalar);
   }
+  refineFill(selection);
 }
 
 void ImageFrame::hideHighlights() {
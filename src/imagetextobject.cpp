@@ -1,68 +1,65 @@
 ﻿#include "../headers/imagetextobject.h"
+#include "../headers/highlightlayer.h"
 #include "opencv2/core.hpp"
 #include "opencv2/imgcodecs.hpp"
 #include "opencv2/imgproc.hpp"
-#include "ui_imagetextobject.h"
 #include <optional>
 
-ImageTextObject::ImageTextObject(QWidget *parent, cv::Mat *__mat)
-    : QWidget(parent), wasSelected{false}, isSelected{false},
-      isPersistent{false}, colorSet{false}, drag{false}, fontSize{14},
-      mat{__mat}, highlightButton{nullptr}, ui(new Ui::ImageTextObject),
-      colorStyle{YELLOW_HIGHLIGHT} {
-  ui->setupUi(this);
-}
+ImageTextObject::ImageTextObject(ImageBuffer *__mat)
+    : wasSelected{false}, isSelected{false}, isPersistent{false},
+      colorSet{false}, drag{false}, fontSize{14}, mat{__mat}, layer{nullptr},
+      options{nullptr}, colorStyle{YELLOW_HIGHLIGHT}, fill{YELLOW_HIGHLIGHT},
+      shown{false}, highlighted{true}, enabled{true}, analysed{false} {}
 
 bool ImageTextObject::moving = false;
 
-ImageTextObject::ImageTextObject(QWidget *parent, const ImageTextObject &old,
-                                 Ui::MainWindow *__ui, cv::Mat *__mat,
+ImageTextObject::ImageTextObject(HighlightLayer *__layer,
+                                 const ImageTextObject &old, ImageBuffer *__mat,
                                  Options *__options)
-    : QWidget(parent), mat{__mat}, options{__options}, mUi{__ui},
-      ui(new Ui::ImageTextObject) {
+    : isSelected{false}, isPersistent{false}, mat{__mat}, layer{__layer},
+      options{__options}, colorStyle{YELLOW_HIGHLIGHT},
+      fill{YELLOW_HIGHLIGHT}, shown{false}, highlighted{true}, enabled{true} {
 
   topLeft = old.topLeft;
   bottomRight = old.bottomRight;
   lineSpace = old.lineSpace;
   fontIntensity = old.fontIntensity;
+  bgIntensity = old.bgIntensity;
+  colorPalette = old.colorPalette;
+  analysed = old.analysed;
   fontSize = old.fontSize;
   colorSet = old.colorSet;
   textMask = old.textMask;
   wasSelected = old.wasSelected;
   drag = old.drag;
 
-  ui->setupUi(this);
   setText(old.getText());
 
   initSizeAndPos();
-  determineBgColor();
-  generatePalette();
-  highlightSpaces();
 }
 
-ImageTextObject::ImageTextObject(QWidget *parent, ImageTextObject &&old,
-                                 Ui::MainWindow *__ui, cv::Mat *__mat,
-                                 Options *__options)
-    : QWidget(parent), mat{__mat}, options{__options}, mUi{__ui},
-      ui(new Ui::ImageTextObject) {
+ImageTextObject::ImageTextObject(HighlightLayer *__layer, ImageTextObject &&old,
+                                 ImageBuffer *__mat, Options *__options)
+    : isSelected{false}, isPersistent{false}, mat{__mat}, layer{__layer},
+      options{__options}, colorStyle{YELLOW_HIGHLIGHT},
+      fill{YELLOW_HIGHLIGHT}, shown{false}, highlighted{true}, enabled{true} {
 
   topLeft = std::move(old.topLeft);
   bottomRight = std::move(old.bottomRight);
   lineSpace = std::move(old.lineSpace);
   fontIntensity = std::move(old.fontIntensity);
+  bgIntensity = std::move(old.bgIntensity);
+  colorPalette = std::move(old.colorPalette);
+  analysed = std::move(old.analysed);
   fontSize = std::move(old.fontSize);
   colorSet = std::move(old.colorSet);
   textMask = std::move(old.textMask);
   drag = std::move(old.drag);
   wasSelected = std::move(old.wasSelected);
 
-  ui->setupUi(this);
   setText(old.getText());
 
   initSizeAndPos();
-  determineBgColor();
-  generatePalette();
-  highlightSpaces();
 }
 
 void ImageTextObject::setFilepath(QString __filepath) { filepath = __filepath; }
@@ -71,40 +68,61 @@ void ImageTextObject::setText(QString __text) { text = __text; }
 
 QString ImageTextObject::getText() const { return text; }
 
-ImageTextObject::~ImageTextObject() {
-  delete ui;
-  delete highlightButton;
+const QVector<cv::Scalar> &ImageTextObject::getPalette() {
+  analyse();
+  return colorPalette;
 }
 
-void ImageTextObject::highlightSpaces() {
-  Highlight *highlight = new Highlight{ui->frame};
-  auto size = lineSpace.second - lineSpace.first;
-
-  highlight->setCursor(Qt::CursorShape::PointingHandCursor);
-  highlight->setMinimumSize(QSize{size.x(), size.y()});
-  highlight->setStyleSheet(YELLOW_HIGHLIGHT);
-  highlight->show();
+cv::Scalar ImageTextObject::getFontColor() {
+  analyse();
+  return fontIntensity;
+}
 
-  QObject::connect(highlight, &Highlight::clicked, this, [=] {
-    if (isPersistent) {
-      mUi->fontSizeInput->setText(QString::number(fontSize));
-      mUi->textEdit->setText(text);
-      highlight->setStyleSheet(GREEN_HIGHLIGHT);
+void ImageTextObject::setFontColor(cv::Scalar color) {
+  analyse();
+  colorSet = true;
+  fontIntensity = color;
+}
 
-      mUi->colorSelect->setStyleSheet(
-          ImageTextObject::formatStyle(fontIntensity));
+cv::Scalar ImageTextObject::getBackgroundColor() {
+  analyse();
+  return bgIntensity;
+}
 
-      emit selection();
-    }
-  });
+// a page can hold thousands of boxes and most are never edited, so the
+// colors are only read once something needs them
+void ImageTextObject::analyse() {
+  if (analysed || !mat || mat->empty()) {
+    return;
+  }
+  analysed = true;
 
-  QObject::connect(highlight, &Highlight::pressed, this, [&] { drag = true; });
-  QObject::connect(highlight, &Highlight::released, this,
-                   [&] { drag = false; });
+  if (mat->type() != CV_8UC3) {
+    qDebug() << "Image must have 3 channels";
+    return;
+  }
+  const cv::Rect box{cv::Point{topLeft.x(), topLeft.y()},
+                    cv::Point{bottomRight.x(), bottomRight.y()}};
+  // the page may still be being quantized, the box alone is counted then
+  if (const ColorIndex *index = mat->colors()) {
+    setColors(index->analyse(box));
+  } else {
+    setColors(analyseColors(*mat, box));
+  }
+}
 
-  highlightButton = highlight;
+// takes over colors read elsewhere, such as ImageFrame::prefetchColors()
+void ImageTextObject::setColors(const ColorStats &stats) {
+  analysed = true;
+  bgIntensity = stats.background;
+  colorPalette = stats.palette;
+  if (!colorSet) {
+    fontIntensity = colorPalette.first();
+  }
 }
 
+bool ImageTextObject::isAnalysed() const { return analysed; }
+
 void ImageTextObject::bound() {
   // bound x
   if (topLeft.x() < 0) {
@@ -128,16 +146,16 @@ void ImageTextObject::initSizeAndPos() {
     qDebug() << "failed to establish size";
     return;
   }
-
-  this->setFixedSize(QSize{size.x(), size.y()});
-  ui->frame->setFixedSize(QSize{size.x(), size.y()});
-  this->adjustSize();
-  ui->frame->adjustSize();
-  this->move(topLeft);
   bound();
 }
 
+QRect ImageTextObject::rect() const {
+  return QRect{topLeft, QSize{bottomRight.x() - topLeft.x(),
+                              bottomRight.y() - topLeft.y()}};
+}
+
 void ImageTextObject::reposition(QPoint shift, bool relative) {
+  const QRect from{topLeft, bottomRight};
   auto newPosTL = relative ? topLeft + shift : shift;
   auto newPosBR =
       relative ? bottomRight + shift : shift + (bottomRight - topLeft);
@@ -166,6 +184,7 @@ void ImageTextObject::reposition(QPoint shift, bool relative) {
   }
 
   if (!moving) {
+    analyse();
     if (options->getFillMethod() == Options::NEIGHBOR) {
       auto region = cv::Rect{cv::Point{topLeft.x(), topLeft.y()},
                              cv::Point{bottomRight.x(), bottomRight.y()}};
@@ -182,6 +201,7 @@ void ImageTextObject::reposition(QPoint shift, bool relative) {
 
   topLeft = newPosTL;
   bottomRight = newPosBR;
+  relocated(from);
 }
 
 // subtract and fill text in new position
@@ -205,265 +225,105 @@ void ImageTextObject::unstageMove() {
   textMask = std::optional<QPair<cv::Mat, cv::Mat>>{};
 }
 
-void ImageTextObject::scaleAndPosition(double scalar) {
-  auto size = scalar * (lineSpace.second - lineSpace.first);
-  highlightButton->setMinimumSize(QSize{size.x(), size.y()});
-  auto tempBR = bottomRight * scalar;
-  auto tempTL = topLeft * scalar;
-
-  lineSpace = QPair<QPoint, QPoint>(tempTL, tempBR);
-  auto boxSize = tempBR - tempTL;
-
-  this->setFixedSize(QSize{boxSize.x(), boxSize.y()});
-  ui->frame->setFixedSize(QSize{boxSize.x(), boxSize.y()});
-  this->adjustSize();
-  ui->frame->adjustSize();
-  this->move(tempTL);
-}
-
 void ImageTextObject::scaleAndPosition(double sx, double sy) {
+  const QRect from{topLeft, bottomRight};
   int sizeX = sx * (lineSpace.second.x() - lineSpace.first.x());
   int sizeY = sy * (lineSpace.second.y() - lineSpace.first.y());
-  highlightButton->setMinimumSize(QSize{sizeX, sizeY});
 
   auto diff = topLeft + QPoint{sizeX, sizeY};
   bottomRight = diff; // added this
   lineSpace = QPair<QPoint, QPoint>(topLeft, diff);
-  auto size = diff - topLeft;
-
-  this->setFixedSize(QSize{size.x(), size.y()});
-  ui->frame->setFixedSize(QSize{size.x(), size.y()});
-  this->adjustSize();
-  ui->frame->adjustSize();
-
-  auto scaleString = mUi->zoomFactor->placeholderText();
-  scaleString = scaleString.remove('%');
-  this->move(topLeft * scaleString.toDouble() / 100);
   bound();
-}
-
-// grabs most frequent colors;
-void ImageTextObject::generatePalette() {
-  cv::Scalar intensity;
-
-  if (!(mat->type() & CV_8UC3)) {
-    qDebug() << "Image must have 3 channels";
-    return;
-  }
-
-  auto left{topLeft.x()}, top{topLeft.y()};
-  auto right{bottomRight.x()}, bottom{bottomRight.y()};
-  if (left == right || top == bottom) {
-    return;
-  }
-
-  auto region = cv::Rect{cv::Point{topLeft.x(), topLeft.y()},
-                         cv::Point{bottomRight.x(), bottomRight.y()}};
-  cv::Mat mask = generateTextMask(region);
-  auto ker = cv::getStructuringElement(cv::MORPH_RECT, {3, 3});
-  cv::cvtColor(mask, mask, cv::COLOR_GRAY2BGR);
-  cv::Mat text = mask & draw;
-
-  QHash<QcvScalar, int> scalars;
-  int max = 0;
-  for (auto i = 0; i < right - left; i++) {
-    for (auto j = 0; j < bottom - top; j++) {
-      QcvScalar key = QcvScalar{text.at<cv::Vec3b>({i, j})};
-      if (!scalars.contains(key)) {
-        scalars[key] = 1;
-      } else {
-        ++scalars[key];
-      }
-      if (max < scalars[key]) {
-        max = scalars[key];
-        intensity = key;
-      }
-    }
-  }
-
-  QVector<cv::Scalar> __colorPalette;
-  typedef QHash<QcvScalar, int>::iterator I;
-
-  auto cmp = [](I lhs, I rhs) -> bool { return lhs.value() < rhs.value(); };
-  std::priority_queue<I, QVector<I>, decltype(cmp)> pq(cmp);
-
-  for (I it = scalars.begin(); it != scalars.end(); ++it) {
-    pq.push(it);
-  }
-
-  for (auto i = 0; i < PALETTE_LIMIT && !pq.empty(); i++) {
-    auto key = pq.top().key();
-    if (cv::Scalar{0, 0, 0} != key) {
-      __colorPalette.push_back(key);
-    }
-    pq.pop();
-  }
-
-  colorPalette = __colorPalette;
-  if (colorPalette.isEmpty()) {
-    colorPalette.push_back(cv::Scalar{0, 0, 0});
-  }
-  fontIntensity = colorPalette.first();
-}
-
-void ImageTextObject::determineBgColor() {
-  cv::Scalar intensity;
-
-  if (!(mat->type() & CV_8UC3)) {
-    qDebug() << "Image must have 3 channels";
-    return;
-  }
-  auto left{topLeft.x()}, top{topLeft.y()};
-  auto right{bottomRight.x()}, bottom{bottomRight.y()};
-  QHash<QcvScalar, int> scalars;
-
-  //  Traverse the outside of the box's edges
-  (left > 0) ? left -= 1 : left;
-  (right < mat->cols - 1) ? right += 1 : right;
-  (top > 0) ? top -= 1 : top;
-  (bottom < mat->rows - 1) ? bottom += 1 : bottom;
-
-  (right == mat->cols) ? right -= 1 : right;
-  (bottom == mat->rows) ? bottom -= 1 : bottom;
-
-  // Top / Bottom
-  for (auto i = left; i < right; i++) {
-    QcvScalar key = QcvScalar{mat->at<cv::Vec3b>(cv::Point{i, top})};
-    if (!scalars.contains(key)) {
-      scalars[key] = 1;
-    } else {
-      ++scalars[key];
-    }
-
-    key = QcvScalar{mat->at<cv::Vec3b>(cv::Point{i, bottom})};
-    if (!scalars.contains(key)) {
-      scalars[key] = 1;
-    } else {
-      ++scalars[key];
-    }
-  }
-
-  //   Right / Left
-  for (auto i = top; i < bottom; i++) {
-    auto key = QcvScalar{mat->at<cv::Vec3b>(cv::Point{left, i})};
-    if (!scalars.contains(key)) {
-      scalars[key] = 1;
-    } else {
-      ++scalars[key];
-    }
-
-    key = QcvScalar{mat->at<cv::Vec3b>(cv::Point{right, i})};
-    if (!scalars.contains(key)) {
-      scalars[key] = 1;
-    } else {
-      ++scalars[key];
-    }
-  }
-
-  int max = 0;
-  for (const auto &key : scalars.keys()) {
-    if (scalars[key] > max) {
-      max = scalars[key];
-      intensity = key;
-    }
-  }
-  bgIntensity = intensity;
+  relocated(from);
 }
 
 std::optional<QPair<cv::Mat, cv::Mat>>
 ImageTextObject::fillBackground(bool move) {
-  if (options->getFillMethod() == Options::INPAINT) {
-    return inpaintingFill(move);
-  } else if (options->getFillMethod() == Options::NEIGHBOR) {
+  analyse();
+  if (options->getFillMethod() == Options::NEIGHBOR) {
     neighboringFill();
+    return {};
   }
-  return {};
+  return inpaintingFill(move);
 }
 
-double whiteComp(const cv::Mat &mat) {
-  int whiteCount = 0;
-  for (int i = 0; i < mat.rows; i++) {
-    for (int j = 0; j < mat.cols; j++) {
-      if (mat.at<uchar>(i, j) == 255) {
-        whiteCount += 1;
-      }
-    }
-  }
-
-  return static_cast<double>(whiteCount) / (mat.rows * mat.cols);
+// the slower fill still owed for the last quick one, if any
+std::optional<FillRequest> ImageTextObject::takeFill() {
+  auto request = std::move(pendingFill);
+  pendingFill.reset();
+  return request;
 }
 
 cv::Mat ImageTextObject::generateTextMask(const cv::Rect &roi) {
-  cv::Mat mask;
-
   try {
     (*mat)(roi).copyTo(draw);
   } catch (const cv::Exception &e) {
     qDebug() << e.what();
   }
 
-  cv::cvtColor(draw, mask, cv::COLOR_BGR2GRAY);
-  cv::threshold(mask, mask, 0, 255, cv::THRESH_OTSU);
-
-  auto whites = whiteComp(mask);
-  if (whites > INVERT_MASK_THRESH) {
-    mask = ~mask;
-  }
-
-  return mask;
+  return ::textMask(draw);
 }
 
-std::optional<QPair<cv::Mat, cv::Mat>>
-ImageTextObject::inpaintingFill(bool move) {
-  cv::Mat gray, mask, dst;
-
+// the box with a border of background around it and the dilated text inside
+FillHole ImageTextObject::textHole() {
   auto bTL = topLeft, bBR = bottomRight;
   auto borderWidth = 3;
-  bool bX, tX, bY, tY;
-  bX = tX = bY = tY = false;
 
   if (bTL.x() - borderWidth >= 0) {
     bTL.setX(bTL.x() - borderWidth);
-    tX = true;
   }
   if (bTL.y() - borderWidth >= 0) {
     bTL.setY(bTL.y() - borderWidth);
-    tY = true;
   }
   if (bBR.x() + borderWidth < mat->cols) {
     bBR.setX(bBR.x() + borderWidth);
-    bX = true;
   }
   if (bBR.y() + borderWidth < mat->rows) {
     bBR.setY(bBR.y() + borderWidth);
-    bY = true;
   }
 
   auto region =
       cv::Rect{cv::Point{bTL.x(), bTL.y()}, cv::Point{bBR.x(), bBR.y()}};
-  mask = generateTextMask(region);
+  cv::Mat mask = generateTextMask(region);
   auto ker = cv::getStructuringElement(cv::MORPH_RECT, {3, 3});
-  cv::dilate(mask, gray, ker, {-1, -1}, 1);
-  cv::inpaint(draw, gray, dst, 3, cv::INPAINT_NS);
+  cv::dilate(mask, mask, ker, {-1, -1}, 1);
+  return FillHole{region, mask};
+}
+
+std::optional<QPair<cv::Mat, cv::Mat>>
+ImageTextObject::inpaintingFill(bool move) {
+  cv::Mat dst;
+
+  // textHole() leaves the pixels under the hole in draw
+  const FillHole hole = textHole();
+  const cv::Rect region = hole.region;
+  cv::Mat gray = hole.mask;
+  const int left = topLeft.x() - region.x, top = topLeft.y() - region.y;
+  const int right = region.br().x - bottomRight.x();
+  const int bottom = region.br().y - bottomRight.y();
+
+  // large regions get the flat background first and the real fill later
+  const auto method = options->getFillMethod();
+  if (region.area() > FILL_SYNC_AREA) {
+    dst = fillRegion(draw, gray, Options::NEIGHBOR, bgIntensity);
+    pendingFill = FillRequest{region, draw.clone(), gray.clone(), dst, method};
+  } else {
+    dst = fillRegion(draw, gray, method, bgIntensity);
+  }
 
   cv::Mat trimmed;
   if (move) {
-    ker = cv::getStructuringElement(cv::MORPH_RECT, {2, 2});
+    auto ker = cv::getStructuringElement(cv::MORPH_RECT, {2, 2});
     cv::erode(gray, gray, ker, {-1, -1}, 1);
     cv::cvtColor(gray, gray, cv::COLOR_GRAY2BGR);
     trimmed = draw & gray;
-    trimmed = trimmed
-                  .rowRange(tY ? borderWidth : 0,
-                            bY ? trimmed.rows - borderWidth : trimmed.rows)
-                  .colRange(tX ? borderWidth : 0,
-                            bX ? trimmed.cols - borderWidth : trimmed.cols);
-    gray = gray.rowRange(tY ? borderWidth : 0,
-                         bY ? gray.rows - borderWidth : gray.rows)
-               .colRange(tX ? borderWidth : 0,
-                         bX ? gray.cols - borderWidth : gray.cols);
+    trimmed = trimmed.rowRange(top, trimmed.rows - bottom)
+                  .colRange(left, trimmed.cols - right);
+    gray = gray.rowRange(top, gray.rows - bottom)
+               .colRange(left, gray.cols - right);
   }
 
-  dst.copyTo(mat->rowRange(bTL.y(), bBR.y()).colRange(bTL.x(), bBR.x()));
+  dst.copyTo((*mat)(region));
 
   if (move)
     return QPair<cv::Mat, cv::Mat>{trimmed, gray};
@@ -494,36 +354,40 @@ void ImageTextObject::neighboringFill() {
 }
 
 void ImageTextObject::highlight() {
-  highlightButton->isHidden() ? highlightButton->show()
-                              : highlightButton->hide();
+  highlighted = !highlighted;
+  repaint();
 }
 
 void ImageTextObject::showHighlight() {
-  this->show();
-  highlightButton->show();
-  highlightButton->setStyleSheet(colorStyle);
+  shown = highlighted = true;
+  fill = colorStyle;
+  repaint();
 }
 
-void ImageTextObject::setHighlightColor(QString __colorStyle) {
-  colorStyle = __colorStyle;
+// shows color until the next restyle without making it the stored color
+void ImageTextObject::paintHighlight(QRgb color) {
+  fill = color;
+  repaint();
 }
 
-QString ImageTextObject::getHighlightColor() { return colorStyle; }
+void ImageTextObject::setHighlightColor(QRgb color) { colorStyle = color; }
+
+QRgb ImageTextObject::getHighlightColor() { return colorStyle; }
 
 void ImageTextObject::selectHighlight() {
-  this->show();
+  shown = highlighted = true;
   isSelected = true;
-  highlightButton->show();
-  highlightButton->setStyleSheet(BLUE_HIGHLIGHT);
+  fill = BLUE_HIGHLIGHT;
+  repaint();
 }
 
 void ImageTextObject::deselect() {
-  highlightButton->setStyleSheet(colorStyle);
+  fill = colorStyle;
   isSelected = false;
-  if (isPersistent) {
-    return;
+  if (!isPersistent) {
+    highlighted = false;
   }
-  highlightButton->hide();
+  repaint();
 }
 
 void ImageTextObject::reset() {
@@ -532,6 +396,36 @@ void ImageTextObject::reset() {
   isPersistent = false;
 }
 
+void ImageTextObject::show() {
+  shown = true;
+  repaint();
+}
+
+void ImageTextObject::hide() {
+  shown = false;
+  repaint();
+}
+
+void ImageTextObject::setDisabled(bool disabled) { enabled = !disabled; }
+
+bool ImageTextObject::isEnabled() const { return enabled; }
+
+bool ImageTextObject::isHighlighted() const { return shown && highlighted; }
+
+QRgb ImageTextObject::highlightFill() const { return fill; }
+
+void ImageTextObject::repaint() {
+  if (layer) {
+    layer->update();
+  }
+}
+
+void ImageTextObject::relocated(const QRect &from) {
+  if (layer) {
+    layer->moved(this, from);
+  }
+}
+
 QString ImageTextObject::formatStyle(cv::Scalar color) {
 
   QString style = "background-color: rgb(";
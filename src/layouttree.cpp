@@ -0,0 +1,164 @@
+﻿#include "../headers/layouttree.h"
+#include <QJsonObject>
+
+void LayoutTree::capture(tesseract::ResultIterator *ri, const QSize &bounds) {
+  int open[tesseract::RIL_SYMBOL + 1] = {-1, -1, -1, -1, -1};
+  int x1, y1, x2, y2;
+
+  do {
+    for (int i = tesseract::RIL_BLOCK; i <= tesseract::RIL_SYMBOL; i++) {
+      const auto RIL = static_cast<tesseract::PageIteratorLevel>(i);
+      if (!ri->IsAtBeginningOf(RIL)) {
+        continue;
+      }
+      if (!ri->BoundingBox(RIL, &x1, &y1, &x2, &y2)) {
+        open[i] = i == tesseract::RIL_BLOCK ? -1 : open[i - 1];
+        continue;
+      }
+
+      x1 = x1 < 0 ? 0 : x1;
+      x1 = x1 > bounds.width() ? bounds.width() - 1 : x1;
+      x2 = x2 < 0 ? 0 : x2;
+      x2 = x2 > bounds.width() ? bounds.width() - 1 : x2;
+
+      y1 = y1 < 0 ? 0 : y1;
+      y1 = y1 > bounds.height() ? bounds.height() - 1 : y1;
+      y2 = y2 < 0 ? 0 : y2;
+      y2 = y2 > bounds.height() ? bounds.height() - 1 : y2;
+
+      char *utf8 = ri->GetUTF8Text(RIL);
+      QString text{utf8};
+      delete[] utf8;
+
+      nodes.push_back(LayoutNode{RIL, text, QPoint{x1, y1}, QPoint{x2, y2},
+                                 ri->Confidence(RIL),
+                                 i == tesseract::RIL_BLOCK ? -1 : open[i - 1]});
+      open[i] = nodes.size() - 1;
+    }
+  } while (ri->Next(tesseract::RIL_SYMBOL));
+}
+
+// Maps boxes from the preprocessed image back onto the region of the original
+// matrix it was cut from.
+void LayoutTree::transform(double scale, int padding, const QPoint &offset,
+                           const QSize &bounds) {
+  auto map = [&](const QPoint &p) {
+    int x = qBound(0, qRound((p.x() - padding) / scale), bounds.width() - 1);
+    int y = qBound(0, qRound((p.y() - padding) / scale), bounds.height() - 1);
+    return QPoint{x, y} + offset;
+  };
+
+  for (auto &node : nodes) {
+    node.topLeft = map(node.topLeft);
+    node.bottomRight = map(node.bottomRight);
+  }
+}
+
+// Merges a tile's tree, keeping only nodes centered inside the tile's core
+// rows. Children of a dropped node are attached to its nearest kept ancestor.
+void LayoutTree::append(const LayoutTree &other, int coreTop, int coreBottom) {
+  QVector<int> remap(other.nodes.size(), -1);
+
+  for (auto i = 0; i < other.nodes.size(); i++) {
+    auto node = other.nodes[i];
+    int parent = node.parent >= 0 ? remap[node.parent] : -1;
+    int center = (node.topLeft.y() + node.bottomRight.y()) / 2;
+
+    if (center < coreTop || center >= coreBottom) {
+      remap[i] = parent;
+      continue;
+    }
+
+    node.parent = parent;
+    nodes.push_back(node);
+    remap[i] = nodes.size() - 1;
+  }
+}
+
+QVector<OcrBox> LayoutTree::boxes(tesseract::PageIteratorLevel RIL) const {
+  QVector<OcrBox> boxes;
+  for (const auto &node : nodes) {
+    if (node.level != RIL || node.text.trimmed() == "") {
+      continue;
+    }
+    boxes.push_back(OcrBox{node.text, node.topLeft, node.bottomRight});
+  }
+  return boxes;
+}
+
+QString LayoutTree::text() const {
+  QString text;
+  for (const auto &node : nodes) {
+    if (node.level == tesseract::RIL_TEXTLINE) {
+      text += node.text;
+    }
+  }
+  return text;
+}
+
+int LayoutTree::find(const QPoint &point,
+                     tesseract::PageIteratorLevel RIL) const {
+  for (auto i = 0; i < nodes.size(); i++) {
+    const auto &node = nodes[i];
+    if (node.level != RIL) {
+      continue;
+    }
+    if (point.x() >= node.topLeft.x() && point.x() <= node.bottomRight.x() &&
+        point.y() >= node.topLeft.y() && point.y() <= node.bottomRight.y()) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+bool LayoutTree::isEmpty() const { return nodes.isEmpty(); }
+
+QJsonArray LayoutTree::toJson() const {
+  QJsonArray array;
+  for (const auto &node : nodes) {
+    array.append(QJsonObject{
+        {"level", node.level},
+        {"text", node.text},
+        {"x", node.topLeft.x()},
+        {"y", node.topLeft.y()},
+        {"width", node.bottomRight.x() - node.topLeft.x()},
+        {"height", node.bottomRight.y() - node.topLeft.y()},
+        {"confidence", node.confidence},
+        {"parent", node.parent},
+    });
+  }
+  return array;
+}
+
+QJsonArray LayoutTree::toJson(const QVector<OcrBox> &boxes) {
+  QJsonArray array;
+  for (const auto &box : boxes) {
+    array.append(QJsonObject{
+        {"text", box.text},
+        {"x", box.topLeft.x()},
+        {"y", box.topLeft.y()},
+        {"width", box.bottomRight.x() - box.topLeft.x()},
+        {"height", box.bottomRight.y() - box.topLeft.y()},
+    });
+  }
+  return array;
+}
+
+LayoutTree LayoutTree::fromJson(const QJsonArray &array) {
+  LayoutTree tree;
+  for (const auto &value : array) {
+    const auto obj = value.toObject();
+    QPoint tl{obj["x"].toInt(), obj["y"].toInt()};
+    QPoint size{obj["width"].toInt(), obj["height"].toInt()};
+
+    tree.nodes.push_back(LayoutNode{
+        static_cast<tesseract::PageIteratorLevel>(obj["level"].toInt()),
+        obj["text"].toString(),
+        tl,
+        tl + size,
+        static_cast<float>(obj["confidence"].toDouble()),
+        obj["parent"].toInt(),
+    });
+  }
+  return tree;
+}
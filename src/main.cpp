@@ -1,13 +1,19 @@
-﻿#include "../headers/mainwindow.h"
+﻿#include "../headers/batch.h"
+#include "../headers/mainwindow.h"
 
 #include <QApplication>
 
 int main(int argc, char *argv[]) {
+  QVector<QString> args{argv + 1, argv + argc};
+  if (args.contains("--batch")) {
+    QCoreApplication a(argc, argv);
+    return Batch{args}.run();
+  }
+
   QApplication a(argc, argv);
   MainWindow w;
   w.show();
 
-  QVector<QString> args{argv + 1, argv + argc};
   if (!args.empty())
     w.loadArgs(args);
 
@@ -1,4 +1,8 @@
 ﻿#include "../headers/mainwindow.h"
+#include "../headers/enginepool.h"
+#include "../headers/historystore.h"
+#include "../headers/ocrcache.h"
+#include "../headers/ocrscheduler.h"
 #include "headers/imageframe.h"
 #include "headers/imagetextobject.h"
 #include "qboxlayout.h"
@@ -53,24 +57,16 @@ void MainWindow::scanSettings() {
     QDir::setCurrent(path);
   }
 
+  // the bundled model is loaded straight from the resource by the pool
   const auto dataFile = options->getDataFile() + ".traineddata";
   if (!QFileInfo{dataFile}.exists()) {
     qDebug() << "Data file " << dataFile
-             << " doesn't exists, using default file "
+             << " doesn't exists, using bundled file "
              << "eng.traineddata";
     options->setDataFile("eng");
-
-    QFile file{"eng.traineddata"}, qrcFile{":/other/eng.traineddata"};
-    if (!qrcFile.open(QFile::ReadOnly | QFile::Text)) {
-      qDebug() << "Failed to open qrc eng.traineddata";
-      return;
-    }
-    if (!file.open(QFile::WriteOnly | QFile::Text)) {
-      qDebug() << "Failed to open eng.traineddata";
-      return;
-    }
-    file.write(qrcFile.readAll());
   }
+
+  EnginePool::instance().warm(options->getDataFile(), options->getOEM());
 }
 
 void MainWindow::readSettings() {
@@ -83,6 +79,36 @@ void MainWindow::readSettings() {
       settings->value("tesseract/DataFile", options->getDataFile()).toString();
   auto fillMethod =
       settings->value("highlight/FillMethod", options->getFillMethod()).toInt();
+  auto tiled = settings->value("tesseract/Tiled", options->getTiled()).toBool();
+  auto tileSize =
+      settings->value("tesseract/TileSize", options->getTileSize()).toInt();
+  auto tileOverlap =
+      settings->value("tesseract/TileOverlap", options->getTileOverlap())
+          .toInt();
+  auto cache = settings->value("cache/Enabled", options->getCache()).toBool();
+  auto cacheSize =
+      settings->value("cache/MaxSizeMB", options->getCacheSize()).toInt();
+  auto preprocess =
+      settings->value("preprocess/Enabled", options->getPreprocess()).toBool();
+  auto binarize =
+      settings->value("preprocess/Binarize", options->getBinarize()).toBool();
+  auto sourceDpi =
+      settings->value("preprocess/SourceDPI", options->getSourceDpi()).toInt();
+  auto targetDpi =
+      settings->value("preprocess/TargetDPI", options->getTargetDpi()).toInt();
+  auto padding =
+      settings->value("preprocess/Padding", options->getPadding()).toInt();
+  auto normalize =
+      settings->value("preprocess/Normalize", options->getNormalize()).toBool();
+  auto ocrJobs =
+      settings->value("scheduler/Jobs", options->getOcrJobs()).toInt();
+  auto ocrMemory =
+      settings->value("scheduler/MemoryMB", options->getOcrMemory()).toInt();
+  auto historyTabMemory =
+      settings->value("history/TabMemoryMB", options->getHistoryTabMemory())
+          .toInt();
+  auto historyMemory =
+      settings->value("history/MemoryMB", options->getHistoryMemory()).toInt();
 
   options->setRIL(static_cast<tesseract::PageIteratorLevel>(RIL));
   options->setOEM(static_cast<tesseract::OcrEngineMode>(OEM));
@@ -90,6 +116,25 @@ void MainWindow::readSettings() {
   options->setDataDir(dataDir);
   options->setDataFile(dataFile);
   options->setFillMethod((Options::fillMethod)fillMethod);
+  options->setTiled(tiled);
+  options->setTileSize(tileSize);
+  options->setTileOverlap(tileOverlap);
+  options->setCache(cache);
+  options->setCacheSize(cacheSize);
+  OcrCache::instance().setMaxSize(cacheSize);
+  options->setPreprocess(preprocess);
+  options->setBinarize(binarize);
+  options->setSourceDpi(sourceDpi);
+  options->setTargetDpi(targetDpi);
+  options->setPadding(padding);
+  options->setNormalize(normalize);
+  options->setOcrJobs(ocrJobs);
+  options->setOcrMemory(ocrMemory);
+  OcrScheduler::instance().setMaxJobs(ocrJobs);
+  OcrScheduler::instance().setMemoryLimit(ocrMemory);
+  options->setHistoryTabMemory(historyTabMemory);
+  options->setHistoryMemory(historyMemory);
+  HistoryStore::setBudget(historyTabMemory, historyMemory);
 }
 
 void MainWindow::writeSettings(bool __default) {
@@ -101,6 +146,21 @@ void MainWindow::writeSettings(bool __default) {
     options->setFillMethod(Options::INPAINT);
     options->setDataDir(defaultPath);
     options->setDataFile("eng");
+    options->setTiled(false);
+    options->setTileSize(DEFAULT_TILE_SIZE);
+    options->setTileOverlap(DEFAULT_TILE_OVERLAP);
+    options->setCache(true);
+    options->setCacheSize(DEFAULT_CACHE_SIZE_MB);
+    options->setPreprocess(true);
+    options->setBinarize(false);
+    options->setSourceDpi(0);
+    options->setTargetDpi(0);
+    options->setPadding(DEFAULT_PADDING);
+    options->setNormalize(true);
+    options->setOcrJobs(0);
+    options->setOcrMemory(DEFAULT_OCR_MEMORY_MB);
+    options->setHistoryTabMemory(DEFAULT_HISTORY_TAB_MB);
+    options->setHistoryMemory(DEFAULT_HISTORY_MB);
   }
 
   settings->setValue("tesseract/RIL", options->getRIL());
@@ -109,17 +169,51 @@ void MainWindow::writeSettings(bool __default) {
   settings->setValue("tesseract/DataDir", options->getDataDir());
   settings->setValue("tesseract/DataFile", options->getDataFile());
   settings->setValue("highlight/FillMethod", options->getFillMethod());
+  settings->setValue("tesseract/Tiled", options->getTiled());
+  settings->setValue("tesseract/TileSize", options->getTileSize());
+  settings->setValue("tesseract/TileOverlap", options->getTileOverlap());
+  settings->setValue("cache/Enabled", options->getCache());
+  settings->setValue("cache/MaxSizeMB", options->getCacheSize());
+  settings->setValue("preprocess/Enabled", options->getPreprocess());
+  settings->setValue("preprocess/Binarize", options->getBinarize());
+  settings->setValue("preprocess/SourceDPI", options->getSourceDpi());
+  settings->setValue("preprocess/TargetDPI", options->getTargetDpi());
+  settings->setValue("preprocess/Padding", options->getPadding());
+  settings->setValue("preprocess/Normalize", options->getNormalize());
+  settings->setValue("scheduler/Jobs", options->getOcrJobs());
+  settings->setValue("scheduler/MemoryMB", options->getOcrMemory());
+  settings->setValue("history/TabMemoryMB", options->getHistoryTabMemory());
+  settings->setValue("history/MemoryMB", options->getHistoryMemory());
   settings->sync();
 }
 
 void MainWindow::on_actionOptions_triggered() {
+  const auto RIL = options->getRIL();
+  const auto dataFile = options->getDataFile();
+  const auto OEM = options->getOEM();
   options->setModal(true);
   if (options->exec() == QDialog::DialogCode::Rejected)
     return;
 
   writeSettings(false);
   readSettings();
+  // engines only depend on the model, other options apply per job
+  if (options->getDataFile() != dataFile || options->getOEM() != OEM) {
+    EnginePool::instance().rebuild();
+  }
   scanSettings();
+
+  if (options->getRIL() != RIL) {
+    for (auto i = 0; i < ui->tab->count(); i++) {
+      auto tab = qobject_cast<TabScroll *>(ui->tab->widget(i));
+      if (tab && tab->iFrame) {
+        tab->iFrame->setGranularity(options->getRIL());
+      }
+    }
+    if (iFrame) {
+      iFrame->renderListView();
+    }
+  }
 }
 
 void MainWindow::on_hide_clicked() {
@@ -141,6 +235,7 @@ void MainWindow::connections() {
   const auto remove = new QShortcut{QKeySequence("Ctrl+R"), this};
   const auto group = new QShortcut{QKeySequence("Ctrl+G"), this};
   const auto __delete = new QShortcut{QKeySequence("Ctrl+D"), this};
+  const auto erase = new QShortcut{QKeySequence("Ctrl+E"), this};
 
   const auto up = new QShortcut{QKeySequence("Shift+Up"), this};
   const auto down = new QShortcut{QKeySequence("Shift+Down"), this};
@@ -165,14 +260,21 @@ void MainWindow::connections() {
     currTab = qobject_cast<TabScroll *>(ui->tab->currentWidget());
     currTab->setEnabled(true);
     iFrame = currTab->iFrame;
+    OcrScheduler::instance().prioritize(iFrame);
 
     emit switchConnections();
   });
 
   QObject::connect(
       ui->tab->tabBar(), &QTabBar::tabCloseRequested, this, [&](int idx) {
-        if (!iFrame || iFrame->isProcessing)
-          return; // to prevent closing on concurrent tess process
+        if (!iFrame)
+          return;
+
+        // stop a running extraction before its frame goes away
+        auto closing = qobject_cast<TabScroll *>(ui->tab->widget(idx));
+        if (closing && closing->iFrame) {
+          closing->iFrame->cancel();
+        }
         delete ui->tab->widget(idx);
 
         if (ui->tab->count() > 0) {
@@ -252,6 +354,13 @@ void MainWindow::connections() {
     }
   });
 
+  QObject::connect(erase, &QShortcut::activated, this, [&] {
+    if (iFrame) {
+      iFrame->keysPressed[Qt::Key_Control] = false;
+      iFrame->eraseSelections();
+    }
+  });
+
   QObject::connect(open, &QShortcut::activated, this, [&] {
     on_actionOpen_Image_triggered();
     if (iFrame)
@@ -302,8 +411,7 @@ void MainWindow::connections() {
         QString style = ImageTextObject::formatStyle(color);
         ImageFrame::defaultColor = color;
 
-        iFrame->selection->colorSet = true;
-        iFrame->selection->fontIntensity = color;
+        iFrame->selection->setFontColor(color);
         ui->colorSelect->setStyleSheet(style);
       }
     };
@@ -333,7 +441,7 @@ void MainWindow::colorTray() {
     return;
 
   if (iFrame->selection) {
-    auto intensity = iFrame->selection->colorPalette.first();
+    auto intensity = iFrame->selection->getPalette().first();
     colorMenu->setColor(intensity);
   }
 
@@ -343,7 +451,7 @@ void MainWindow::colorTray() {
   QVector<QHBoxLayout *> layouts;
   QHBoxLayout *curr;
 
-  for (const auto &color : iFrame->selection->colorPalette) {
+  for (const auto &color : iFrame->selection->getPalette()) {
     if (layouts.empty() || curr->count() % 5 == 0) {
       layouts.push_back(curr = new QHBoxLayout);
       colorMenu->palette->addLayout(curr);
@@ -426,6 +534,11 @@ void MainWindow::on_actionGroup_Ctrl_G_triggered() {
     iFrame->groupSelections();
 }
 
+void MainWindow::on_actionErase_Ctrl_E_triggered() {
+  if (iFrame)
+    iFrame->eraseSelections();
+}
+
 void MainWindow::keyPressEvent(QKeyEvent *event) {
   if (!iFrame)
     return;
@@ -499,7 +612,6 @@ void MainWindow::on_actionOpen_Image_triggered(bool paste) {
   iFrame =
       new ImageFrame(tabUi->scrollAreaWidgetContents, tabScroll, ui, options);
   tabUi->scrollHorizontalLayout->addWidget(iFrame);
-  iFrame->getState() = new ImageFrame::State;
   tabScroll->iFrame = iFrame;
   currTab = tabScroll;
   ui->tab->setCurrentWidget(tabScroll);
@@ -528,6 +640,7 @@ void MainWindow::loadImage(QString fileName) {
   }
 
   tabUi->scrollHorizontalLayout->addWidget(iFrame);
+  OcrScheduler::instance().prioritize(iFrame);
   iFrame->setImage(fileName);
   tabScroll->iFrame = iFrame;
   currTab = tabScroll;
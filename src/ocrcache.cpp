@@ -0,0 +1,138 @@
+﻿#include "../headers/ocrcache.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutexLocker>
+#include <QSaveFile>
+
+OcrCache::OcrCache()
+    : dir{QDir::homePath() + "/.config/tfi/cache/"},
+      maxSize{DEFAULT_CACHE_SIZE_MB * 1024LL * 1024LL}, size{-1} {
+  QDir{}.mkpath(dir);
+}
+
+OcrCache &OcrCache::instance() {
+  static OcrCache cache;
+  return cache;
+}
+
+QByteArray OcrCache::key(const TiledImage &image, const OcrConfig &config) {
+  QCryptographicHash hash{QCryptographicHash::Sha1};
+
+  // read a strip of tiles at a time, the key is the same as hashing the
+  // whole matrix row by row
+  const cv::Mat first = image.read(cv::Rect{0, 0, 1, 1});
+  const int header[] = {image.cols(), image.rows(), first.type()};
+  hash.addData(reinterpret_cast<const char *>(header), sizeof(header));
+  const auto rowBytes = static_cast<int>(image.cols() * first.elemSize());
+  for (auto y = 0; y < image.rows(); y += IMAGE_TILE_SIZE) {
+    const cv::Mat strip = image.read(cv::Rect{
+        0, y, image.cols(), qMin(IMAGE_TILE_SIZE, image.rows() - y)});
+    for (auto i = 0; i < strip.rows; i++) {
+      hash.addData(reinterpret_cast<const char *>(strip.ptr(i)), rowBytes);
+    }
+  }
+
+  // RIL is left out, the cached layout holds every level
+  QString settings = QString{"layout%1:%2:%3:%4:%5:%6:%7"}
+                         .arg(CACHE_VERSION)
+                         .arg(config.OEM)
+                         .arg(config.PSM)
+                         .arg(config.dataFile)
+                         .arg(config.tiled)
+                         .arg(config.tileSize)
+                         .arg(config.tileOverlap);
+  if (config.preprocess) {
+    settings += QString{":pre:%1:%2:%3:%4:%5"}
+                    .arg(config.binarize)
+                    .arg(config.normalize)
+                    .arg(config.sourceDpi)
+                    .arg(config.targetDpi)
+                    .arg(config.padding);
+  }
+  hash.addData(settings.toUtf8());
+
+  return hash.result().toHex();
+}
+
+bool OcrCache::lookup(const QByteArray &key, QString &text,
+                      LayoutTree &layout) {
+  QFile file{dir + key + ".json"};
+  if (!file.open(QFile::ReadOnly)) {
+    return false;
+  }
+
+  const auto json = QJsonDocument::fromJson(file.readAll()).object();
+  if (json.isEmpty()) {
+    return false;
+  }
+
+  // mtime doubles as the LRU timestamp, on Unix the descriptor is touched
+  // without write access
+  file.setFileTime(QDateTime::currentDateTime(),
+                   QFileDevice::FileModificationTime);
+
+  text = json["text"].toString();
+  layout = LayoutTree::fromJson(json["layout"].toArray());
+  return true;
+}
+
+void OcrCache::store(const QByteArray &key, const QString &text,
+                     const LayoutTree &layout) {
+  QJsonObject json{{"text", text}, {"layout", layout.toJson()}};
+  const auto data = QJsonDocument{json}.toJson(QJsonDocument::Compact);
+
+  const QString path = dir + key + ".json";
+  // an entry recognized again replaces the old file, which is counted once
+  const qint64 replaced = QFileInfo{path}.size();
+  QSaveFile file{path};
+  if (!file.open(QFile::WriteOnly)) {
+    return;
+  }
+  file.write(data);
+  if (!file.commit()) {
+    return;
+  }
+
+  QMutexLocker lock{&mutex};
+  if (size < 0) {
+    size = 0;
+    for (const auto &entry : QDir{dir}.entryInfoList({"*.json"}, QDir::Files)) {
+      size += entry.size();
+    }
+  } else {
+    size += data.size() - replaced;
+  }
+
+  if (size > maxSize) {
+    evict();
+  }
+}
+
+void OcrCache::setMaxSize(int megabytes) {
+  QMutexLocker lock{&mutex};
+  maxSize = megabytes * 1024LL * 1024LL;
+}
+
+// drops the oldest entries until the cache is back under 3/4 of the limit
+void OcrCache::evict() {
+  auto entries = QDir{dir}.entryInfoList({"*.json"}, QDir::Files,
+                                         QDir::Time | QDir::Reversed);
+  size = 0;
+  for (const auto &entry : entries) {
+    size += entry.size();
+  }
+
+  for (const auto &entry : entries) {
+    if (size <= maxSize * 3 / 4) {
+      break;
+    }
+    if (QFile::remove(entry.absoluteFilePath())) {
+      size -= entry.size();
+    }
+  }
+}
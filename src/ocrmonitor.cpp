@@ -0,0 +1,40 @@
+﻿#include "../headers/ocrmonitor.h"
+#include <QMutexLocker>
+
+void OcrMonitor::begin(int regions) {
+  QMutexLocker lock{&mutex};
+  percents = QVector<int>(regions, 0);
+  reported = -1;
+}
+
+// overall progress is the mean over regions, only reported when it moves
+void OcrMonitor::update(int region, int percent) {
+  QMutexLocker lock{&mutex};
+  if (region < 0 || region >= percents.size()) {
+    return;
+  }
+  percents[region] = qBound(0, percent, 100);
+
+  int total = 0;
+  for (const auto &p : percents) {
+    total += p;
+  }
+  total /= percents.size();
+
+  if (total != reported) {
+    reported = total;
+    if (progressed) {
+      progressed(total);
+    }
+  }
+}
+
+void OcrMonitor::publish(const LayoutTree &piece) {
+  if (recognized && !piece.isEmpty() && !isCancelled()) {
+    recognized(piece);
+  }
+}
+
+void OcrMonitor::cancel() { cancelled = true; }
+
+bool OcrMonitor::isCancelled() const { return cancelled; }
@@ -0,0 +1,150 @@
+﻿#include "../headers/ocrscheduler.h"
+#include "../headers/timing.h"
+#include <QMutexLocker>
+#include <QThread>
+#include <QVector>
+#include <QtConcurrent/QtConcurrent>
+#include <atomic>
+
+OcrScheduler::OcrScheduler() {
+  pool.setMaxThreadCount(QThread::idealThreadCount());
+}
+
+OcrScheduler &OcrScheduler::instance() {
+  static OcrScheduler scheduler;
+  return scheduler;
+}
+
+QFuture<void> OcrScheduler::submit(const void *owner, qint64 bytes,
+                                   std::function<void()> task) {
+  Job job{owner, bytes, task, QFutureInterface<void>{}, QElapsedTimer{}};
+  job.future.reportStarted();
+  job.waiting.start();
+  auto future = job.future.future();
+
+  QMutexLocker lock{&mutex};
+  queue.push_back(job);
+  dispatch();
+
+  return future;
+}
+
+// drops the owner's jobs that have not started yet
+void OcrScheduler::withdraw(const void *owner) {
+  QMutexLocker lock{&mutex};
+  for (auto i = queue.size() - 1; i >= 0; i--) {
+    if (queue[i].owner == owner) {
+      queue[i].future.reportFinished();
+      queue.removeAt(i);
+    }
+  }
+}
+
+// Runs task(0) to task(count - 1) for the parts of a running job. The caller
+// works through them itself and borrows only the workers that are free, which
+// count as running jobs meanwhile, so a tiled page stays within the limit.
+void OcrScheduler::parallel(int count,
+                            const std::function<void(int)> &task) {
+  std::atomic<int> next{0};
+  const auto work = [&next, &task, count] {
+    for (auto i = next++; i < count; i = next++) {
+      task(i);
+    }
+  };
+
+  int helpers = 0;
+  {
+    QMutexLocker lock{&mutex};
+    helpers = qBound(0, pool.maxThreadCount() - running, count - 1);
+    running += helpers;
+  }
+
+  QVector<QFuture<void>> borrowed;
+  for (auto i = 0; i < helpers; i++) {
+    borrowed.push_back(QtConcurrent::run(&pool, work));
+  }
+  work();
+  for (auto &future : borrowed) {
+    future.waitForFinished();
+  }
+
+  QMutexLocker lock{&mutex};
+  running -= helpers;
+  dispatch();
+}
+
+void OcrScheduler::prioritize(const void *owner) {
+  QMutexLocker lock{&mutex};
+  visible = owner;
+  dispatch();
+}
+
+void OcrScheduler::setMaxJobs(int jobs) {
+  QMutexLocker lock{&mutex};
+  pool.setMaxThreadCount(jobs > 0 ? jobs : QThread::idealThreadCount());
+  dispatch();
+}
+
+void OcrScheduler::setMemoryLimit(int megabytes) {
+  QMutexLocker lock{&mutex};
+  memoryLimit = megabytes * 1024LL * 1024LL;
+  dispatch();
+}
+
+SchedulerStats OcrScheduler::stats() {
+  QMutexLocker lock{&mutex};
+  return SchedulerStats{queue.size(), running, finished,
+                        waitMs, runMs, maxWaitMs};
+}
+
+// Starts queued jobs while there are free workers, called with the mutex
+// held. The first job of the visible tab that fits wins, otherwise the oldest
+// that fits. A job bigger than the limit still runs once nothing else does.
+void OcrScheduler::dispatch() {
+  while (running < pool.maxThreadCount() && !queue.isEmpty()) {
+    int next = -1;
+    for (auto i = 0; i < queue.size(); i++) {
+      if (running > 0 && inFlight + queue[i].bytes > memoryLimit) {
+        continue;
+      }
+      if (queue[i].owner == visible) {
+        next = i;
+        break;
+      }
+      if (next == -1) {
+        next = i;
+      }
+    }
+    if (next == -1) {
+      return;
+    }
+
+    Job job = queue.takeAt(next);
+    const qint64 waited = job.waiting.elapsed();
+    running++;
+    inFlight += job.bytes;
+    waitMs += waited;
+    maxWaitMs = qMax(maxWaitMs, waited);
+
+    QtConcurrent::run(&pool, [this, job, waited] { execute(job, waited); });
+  }
+}
+
+void OcrScheduler::execute(Job job, qint64 waited) {
+  QElapsedTimer timer;
+  timer.start();
+  job.task();
+  job.future.reportFinished();
+  const qint64 ran = timer.elapsed();
+
+  QMutexLocker lock{&mutex};
+  running--;
+  finished++;
+  inFlight -= job.bytes;
+  runMs += ran;
+
+  qCDebug(lcTiming) << "OCR job waited" << waited << "ms, ran" << ran << "ms,"
+                    << queue.size() << "queued," << running << "running";
+
+  dispatch();
+}
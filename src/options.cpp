@@ -12,14 +12,8 @@ Options::Options(QWidget *parent) : QDialog(parent), ui(new Ui::Options) {
       ui->fillMethod,
       static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged),
       this, [&](int idx) {
-        if (static_cast<Options::fillMethod>(idx) == Options::NEIGHBOR) {
-          ui->fillMethod->setToolTip(
-              "Use the most frequent color around the edges of the highlight");
-        } else {
-          ui->fillMethod->setToolTip(
-              "Use inpainting to fill in the missing background (Useful if the "
-              "background pixels are not the same color)");
-        }
+        ui->fillMethod->setToolTip(
+            fillTip(static_cast<Options::fillMethod>(idx)));
       });
 }
 
@@ -146,17 +140,29 @@ void Options::setPSM(tesseract::PageSegMode PSM) {
 }
 
 void Options::setFillMethod(Options::fillMethod option) {
-  if (option == Options::NEIGHBOR) {
-    ui->fillMethod->setToolTip(
-        "Use the most frequent color around the edges of the highlight");
-  } else {
-    ui->fillMethod->setToolTip(
-        "Use inpainting to fill in the missing background (Useful if the "
-        "background pixels are not the same color)");
-  }
+  ui->fillMethod->setToolTip(fillTip(option));
   ui->fillMethod->setCurrentIndex(static_cast<int>(option));
 }
 
+// inpainting shows the neighboring fill at once on large regions and swaps
+// in the chosen method when it is done
+QString Options::fillTip(Options::fillMethod option) {
+  switch (option) {
+  case Options::NEIGHBOR:
+    return "Use the most frequent color around the edges of the highlight";
+  case Options::TELEA:
+    return "Use fast inpainting to fill in the missing background (Useful if "
+           "the background pixels are not the same color)";
+  case Options::MULTISCALE:
+    return "Use inpainting at several scales to fill in the missing "
+           "background (Best for large highlights over patterns or "
+           "gradients, slowest)";
+  default:
+    return "Use inpainting to fill in the missing background (Useful if the "
+           "background pixels are not the same color)";
+  }
+}
+
 Options::fillMethod Options::getFillMethod() {
   return static_cast<Options::fillMethod>(ui->fillMethod->currentIndex());
 }
@@ -173,4 +179,129 @@ QString Options::getDataDir() { return ui->dataDir->text(); }
 
 QString Options::getDataFile() { return ui->dataFile->text(); }
 
+void Options::setTiled(bool tiled) { ui->tiled->setChecked(tiled); }
+
+void Options::setTileSize(int size) { ui->tileSize->setValue(size); }
+
+void Options::setTileOverlap(int overlap) {
+  ui->tileOverlap->setValue(overlap);
+}
+
+bool Options::getTiled() { return ui->tiled->isChecked(); }
+
+int Options::getTileSize() { return ui->tileSize->value(); }
+
+int Options::getTileOverlap() { return ui->tileOverlap->value(); }
+
+void Options::setCache(bool cache) { ui->cache->setChecked(cache); }
+
+void Options::setCacheSize(int megabytes) {
+  ui->cacheSize->setValue(megabytes);
+}
+
+bool Options::getCache() { return ui->cache->isChecked(); }
+
+int Options::getCacheSize() { return ui->cacheSize->value(); }
+
+void Options::setPreprocess(bool preprocess) {
+  ui->preprocess->setChecked(preprocess);
+}
+
+void Options::setBinarize(bool binarize) { ui->binarize->setChecked(binarize); }
+
+void Options::setSourceDpi(int dpi) { ui->sourceDpi->setValue(dpi); }
+
+void Options::setTargetDpi(int dpi) { ui->targetDpi->setValue(dpi); }
+
+void Options::setPadding(int padding) { ui->padding->setValue(padding); }
+
+bool Options::getPreprocess() { return ui->preprocess->isChecked(); }
+
+bool Options::getBinarize() { return ui->binarize->isChecked(); }
+
+int Options::getSourceDpi() { return ui->sourceDpi->value(); }
+
+int Options::getTargetDpi() { return ui->targetDpi->value(); }
+
+int Options::getPadding() { return ui->padding->value(); }
+
+void Options::setNormalize(bool normalize) {
+  ui->normalize->setChecked(normalize);
+}
+
+bool Options::getNormalize() { return ui->normalize->isChecked(); }
+
+void Options::setOcrJobs(int jobs) { ui->ocrJobs->setValue(jobs); }
+
+void Options::setOcrMemory(int megabytes) {
+  ui->ocrMemory->setValue(megabytes);
+}
+
+int Options::getOcrJobs() { return ui->ocrJobs->value(); }
+
+int Options::getOcrMemory() { return ui->ocrMemory->value(); }
+
+void Options::setHistoryTabMemory(int megabytes) {
+  ui->historyTabMemory->setValue(megabytes);
+}
+
+void Options::setHistoryMemory(int megabytes) {
+  ui->historyMemory->setValue(megabytes);
+}
+
+int Options::getHistoryTabMemory() { return ui->historyTabMemory->value(); }
+
+int Options::getHistoryMemory() { return ui->historyMemory->value(); }
+
+// Keeps hand edited settings within what the spinboxes allow. A band must
+// move the cut forward, and its overlap may not reach past the next cut.
+static OcrConfig boundTiles(OcrConfig config) {
+  config.tileSize = qBound(MIN_TILE_SIZE, config.tileSize, MAX_TILE_SIZE);
+  config.tileOverlap = qBound(0, config.tileOverlap, config.tileSize / 2);
+  return config;
+}
+
+// Snapshot taken on the GUI thread so recognition never touches the widgets
+OcrConfig Options::getConfig() {
+  return boundTiles(OcrConfig{
+      getRIL(),
+      getOEM(),
+      getPSM(),
+      getDataFile(),
+      getTiled(),
+      getTileSize(),
+      getTileOverlap(),
+      getCache(),
+      getPreprocess(),
+      getBinarize(),
+      getNormalize(),
+      getSourceDpi(),
+      getTargetDpi(),
+      getPadding(),
+  });
+}
+
+OcrConfig Options::configFromSettings(const QSettings &settings) {
+  auto RIL = settings.value("tesseract/RIL", tesseract::RIL_WORD).toInt();
+  auto OEM = settings.value("tesseract/OEM", tesseract::OEM_DEFAULT).toInt();
+  auto PSM = settings.value("tesseract/PSM", tesseract::PSM_AUTO).toInt();
+
+  return boundTiles(OcrConfig{
+      static_cast<tesseract::PageIteratorLevel>(RIL),
+      static_cast<tesseract::OcrEngineMode>(OEM),
+      static_cast<tesseract::PageSegMode>(PSM),
+      settings.value("tesseract/DataFile", "eng").toString(),
+      settings.value("tesseract/Tiled", false).toBool(),
+      settings.value("tesseract/TileSize", DEFAULT_TILE_SIZE).toInt(),
+      settings.value("tesseract/TileOverlap", DEFAULT_TILE_OVERLAP).toInt(),
+      settings.value("cache/Enabled", true).toBool(),
+      settings.value("preprocess/Enabled", true).toBool(),
+      settings.value("preprocess/Binarize", false).toBool(),
+      settings.value("preprocess/Normalize", true).toBool(),
+      settings.value("preprocess/SourceDPI", 0).toInt(),
+      settings.value("preprocess/TargetDPI", 0).toInt(),
+      settings.value("preprocess/Padding", DEFAULT_PADDING).toInt(),
+  });
+}
+
 void Options::on_pushButton_clicked() { ui->stackedWidget->setCurrentIndex(0); }
@@ -0,0 +1,111 @@
+﻿#include "../headers/preprocess.h"
+#include <algorithm>
+#include <vector>
+
+// grayscale -> rescale -> binarize -> pad. cvtColor, resize and
+// adaptiveThreshold all run on OpenCV's vectorized kernels.
+Prepared preprocess(const cv::Mat &matrix, const OcrConfig &config) {
+  Prepared prepared{cv::Mat{}, 1.0, 0, 0};
+  cv::Mat image;
+
+  cv::cvtColor(matrix, image, cv::COLOR_BGR2GRAY);
+
+  if (config.sourceDpi > 0 && config.targetDpi > 0) {
+    double scale = static_cast<double>(config.targetDpi) / config.sourceDpi;
+    scale = qBound(RESCALE_MIN, scale, RESCALE_MAX);
+
+    if (scale != 1.0) {
+      cv::resize(image, image, {}, scale, scale,
+                 scale < 1.0 ? cv::INTER_AREA : cv::INTER_CUBIC);
+    }
+    prepared.scale = scale;
+    prepared.dpi = config.targetDpi;
+  } else if (config.normalize) {
+    const double height = glyphHeight(image);
+    if (height > 0) {
+      double scale = qBound(RESCALE_MIN, GLYPH_HEIGHT_TARGET / height,
+                            RESCALE_MAX);
+
+      if (qAbs(scale - 1.0) > NORMALIZE_TOLERANCE) {
+        cv::resize(image, image, {}, scale, scale,
+                   scale < 1.0 ? cv::INTER_AREA : cv::INTER_CUBIC);
+        prepared.scale = scale;
+      }
+      // glyphs of this size are what Tesseract sees from a 300 DPI scan
+      prepared.dpi = NORMALIZED_DPI;
+    }
+  }
+
+  if (!prepared.dpi && config.sourceDpi > 0) {
+    prepared.dpi = config.sourceDpi;
+  }
+
+  if (config.binarize) {
+    cv::adaptiveThreshold(image, image, 255, cv::ADAPTIVE_THRESH_GAUSSIAN_C,
+                          cv::THRESH_BINARY, BINARIZE_BLOCK_SIZE,
+                          BINARIZE_OFFSET);
+  }
+
+  if (config.padding > 0) {
+    if (config.binarize) {
+      cv::copyMakeBorder(image, image, config.padding, config.padding,
+                         config.padding, config.padding, cv::BORDER_CONSTANT,
+                         cv::Scalar{255});
+    } else {
+      cv::copyMakeBorder(image, image, config.padding, config.padding,
+                         config.padding, config.padding, cv::BORDER_REPLICATE);
+    }
+    prepared.padding = config.padding;
+  }
+
+  prepared.image = image;
+  return prepared;
+}
+
+// Median height of the connected components that look like glyphs, or 0 when
+// there are too few of them to tell. Huge inputs are measured on a downscaled
+// copy and the result is scaled back up.
+double glyphHeight(const cv::Mat &gray) {
+  double factor = 1.0;
+  cv::Mat image = gray;
+
+  const int longest = std::max(gray.cols, gray.rows);
+  if (longest > GLYPH_ANALYSIS_SIZE) {
+    factor = static_cast<double>(GLYPH_ANALYSIS_SIZE) / longest;
+    cv::resize(gray, image, {}, factor, factor, cv::INTER_AREA);
+  }
+
+  cv::Mat ink;
+  cv::threshold(image, ink, 0, 255, cv::THRESH_BINARY_INV | cv::THRESH_OTSU);
+  // light text on a dark background
+  if (static_cast<size_t>(cv::countNonZero(ink)) > ink.total() / 2) {
+    cv::bitwise_not(ink, ink);
+  }
+
+  cv::Mat labels, stats, centroids;
+  const int count =
+      cv::connectedComponentsWithStats(ink, labels, stats, centroids, 8);
+
+  std::vector<int> heights;
+  heights.reserve(count);
+  for (auto i = 1; i < count; i++) {
+    const int width = stats.at<int>(i, cv::CC_STAT_WIDTH);
+    const int height = stats.at<int>(i, cv::CC_STAT_HEIGHT);
+    const int area = stats.at<int>(i, cv::CC_STAT_AREA);
+
+    // skip specks, rules, borders and pictures
+    if (height < 3 || height > ink.rows / 4 || width > height * 4 ||
+        area < width * height / 10) {
+      continue;
+    }
+    heights.push_back(height);
+  }
+
+  if (static_cast<int>(heights.size()) < GLYPH_MIN_COUNT) {
+    return 0;
+  }
+
+  auto median = heights.begin() + heights.size() / 2;
+  std::nth_element(heights.begin(), median, heights.end());
+  return *median / factor;
+}
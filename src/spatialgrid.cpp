@@ -0,0 +1,92 @@
+﻿#include "../headers/spatialgrid.h"
+#include "../headers/imagetextobject.h"
+#include <QSet>
+#include <algorithm>
+
+static inline int cell(int coordinate) {
+  return coordinate >= 0 ? coordinate / GRID_CELL_SIZE
+                         : (coordinate + 1) / GRID_CELL_SIZE - 1;
+}
+
+// corners included, the way boxes are compared everywhere else
+static inline QRect box(const ImageTextObject *obj) {
+  return QRect{obj->topLeft, obj->bottomRight};
+}
+
+void SpatialGrid::build(const QVector<ImageTextObject *> &objects) {
+  clear();
+  ranks.reserve(objects.size());
+  for (auto i = 0; i < objects.size(); i++) {
+    ranks[objects[i]] = i;
+    insert(objects[i], box(objects[i]));
+  }
+}
+
+// from is the box obj had when it was last indexed
+void SpatialGrid::move(ImageTextObject *obj, const QRect &from) {
+  if (!ranks.contains(obj)) {
+    return;
+  }
+  remove(obj, from);
+  insert(obj, box(obj));
+}
+
+// Objects whose cells overlap rect, once each and in list order. Callers
+// still test the boxes themselves.
+QVector<ImageTextObject *> SpatialGrid::query(const QRect &rect) const {
+  QVector<ImageTextObject *> found;
+  QSet<ImageTextObject *> seen;
+
+  for (auto y = cell(rect.top()); y <= cell(rect.bottom()); y++) {
+    for (auto x = cell(rect.left()); x <= cell(rect.right()); x++) {
+      const auto it = cells.constFind({x, y});
+      if (it == cells.constEnd()) {
+        continue;
+      }
+      for (const auto &obj : it.value()) {
+        if (!seen.contains(obj)) {
+          seen.insert(obj);
+          found.push_back(obj);
+        }
+      }
+    }
+  }
+
+  std::sort(found.begin(), found.end(),
+            [&](ImageTextObject *a, ImageTextObject *b) {
+              return ranks.value(a) < ranks.value(b);
+            });
+  return found;
+}
+
+bool SpatialGrid::contains(ImageTextObject *obj) const {
+  return ranks.contains(obj);
+}
+
+void SpatialGrid::clear() {
+  cells.clear();
+  ranks.clear();
+}
+
+void SpatialGrid::insert(ImageTextObject *obj, const QRect &box) {
+  for (auto y = cell(box.top()); y <= cell(box.bottom()); y++) {
+    for (auto x = cell(box.left()); x <= cell(box.right()); x++) {
+      cells[{x, y}].push_back(obj);
+    }
+  }
+}
+
+void SpatialGrid::remove(ImageTextObject *obj, const QRect &box) {
+  for (auto y = cell(box.top()); y <= cell(box.bottom()); y++) {
+    for (auto x = cell(box.left()); x <= cell(box.right()); x++) {
+      auto it = cells.find({x, y});
+      if (it == cells.end()) {
+        continue;
+      }
+      it.value().removeOne(obj);
+      if (it.value().isEmpty()) {
+        cells.erase(it);
+      }
+    }
+  }
+}
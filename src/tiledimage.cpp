@@ -0,0 +1,86 @@
+﻿#include "../headers/tiledimage.h"
+#include <QReadLocker>
+#include <QWriteLocker>
+
+TiledImage::TiledImage(const cv::Mat &image) : image{image} {}
+
+// Copied out tile by tile under the lock, so a tile is either read before
+// the editor preserves it or taken from the preserved copy.
+cv::Mat TiledImage::read(const cv::Rect &region) const {
+  const cv::Rect r = region & cv::Rect{0, 0, image.cols, image.rows};
+  cv::Mat out{r.size(), image.type()};
+  if (r.empty()) {
+    return out;
+  }
+
+  QReadLocker locker{&lock};
+  if (tiles.isEmpty()) {
+    image(r).copyTo(out);
+    return out;
+  }
+
+  for (auto y = r.y / IMAGE_TILE_SIZE; y <= (r.br().y - 1) / IMAGE_TILE_SIZE;
+       y++) {
+    for (auto x = r.x / IMAGE_TILE_SIZE;
+         x <= (r.br().x - 1) / IMAGE_TILE_SIZE; x++) {
+      const Key key{x, y};
+      const cv::Rect bounds = tile(key);
+      const cv::Rect part = bounds & r;
+      const cv::Rect to = part - r.tl();
+
+      const auto it = tiles.constFind(key);
+      if (it == tiles.constEnd()) {
+        image(part).copyTo(out(to));
+      } else {
+        it.value()(part - bounds.tl()).copyTo(out(to));
+      }
+    }
+  }
+  return out;
+}
+
+// called by the editor before it writes inside region
+void TiledImage::preserve(const cv::Rect &region) {
+  const cv::Rect r = region & cv::Rect{0, 0, image.cols, image.rows};
+  if (r.empty()) {
+    return;
+  }
+
+  QWriteLocker locker{&lock};
+  for (auto y = r.y / IMAGE_TILE_SIZE; y <= (r.br().y - 1) / IMAGE_TILE_SIZE;
+       y++) {
+    for (auto x = r.x / IMAGE_TILE_SIZE;
+         x <= (r.br().x - 1) / IMAGE_TILE_SIZE; x++) {
+      const Key key{x, y};
+      if (!tiles.contains(key)) {
+        tiles.insert(key, image(tile(key)).clone());
+      }
+    }
+  }
+}
+
+int TiledImage::rows() const { return image.rows; }
+
+int TiledImage::cols() const { return image.cols; }
+
+int TiledImage::preserved() const {
+  QReadLocker locker{&lock};
+  return tiles.size();
+}
+
+// where the image has been written since the snapshot was taken
+QVector<cv::Rect> TiledImage::preservedRegions() const {
+  QReadLocker locker{&lock};
+  QVector<cv::Rect> regions;
+  regions.reserve(tiles.size());
+  for (auto it = tiles.constBegin(); it != tiles.constEnd(); ++it) {
+    regions.push_back(tile(it.key()));
+  }
+  return regions;
+}
+
+cv::Rect TiledImage::tile(const Key &key) const {
+  return cv::Rect{key.first * IMAGE_TILE_SIZE, key.second * IMAGE_TILE_SIZE,
+                  IMAGE_TILE_SIZE, IMAGE_TILE_SIZE} &
+         cv::Rect{0, 0, image.cols, image.rows};
+}
@@ -0,0 +1,3 @@
+﻿#include "../headers/timing.h"
+
+Q_LOGGING_CATEGORY(lcTiming, "tfi.timing", QtInfoMsg)
@@ -0,0 +1,101 @@
+﻿#include "../headers/zoompyramid.h"
+
+// Renders the view rectangle of the image scaled by scale. Upscaling uses an
+// exact affine map so neighbouring tiles line up at any zoom, downscaling
+// area-resizes the matching part of the nearest level.
+cv::Mat ZoomPyramid::render(const cv::Mat &matrix, double scale,
+                            const cv::Rect &view) {
+  sync(matrix);
+
+  int k = 0;
+  while (k < PYRAMID_LEVELS && scale <= 1.0 / (2 << k)) {
+    k++;
+  }
+  const cv::Mat &src = k == 0 ? base : level(k - 1);
+  const double f = scale * (1 << k);
+
+  cv::Mat out;
+  if (f >= 1.0) {
+    cv::Mat map = (cv::Mat_<double>(2, 3) << f, 0, -view.x, 0, f, -view.y);
+    cv::warpAffine(src, out, map, view.size(), cv::INTER_LINEAR,
+                   cv::BORDER_REPLICATE);
+    return out;
+  }
+
+  cv::Rect srcRect{cvFloor(view.x / f), cvFloor(view.y / f),
+                   cvCeil(view.width / f), cvCeil(view.height / f)};
+  srcRect &= cv::Rect{0, 0, src.cols, src.rows};
+  cv::resize(src(srcRect), out, view.size(), 0, 0, cv::INTER_AREA);
+  return out;
+}
+
+// A different buffer means the image was replaced (undo, redo, new text)
+// rather than edited, so every level is dropped. Holding on to base keeps the
+// old buffer alive, which stops a new one from reusing its address.
+void ZoomPyramid::sync(const cv::Mat &matrix) {
+  if (matrix.data != base.data || matrix.size() != base.size()) {
+    clear();
+    base = matrix;
+  }
+  refresh();
+}
+
+void ZoomPyramid::invalidate(const cv::Rect &region) {
+  if (!levels.isEmpty()) {
+    dirty.push_back(region);
+  }
+}
+
+// Swaps in another matrix that only differs from the current one inside
+// changed, as after an undo or redo.
+void ZoomPyramid::replace(const cv::Mat &matrix, const cv::Rect &changed) {
+  if (matrix.size() != base.size()) {
+    clear();
+    return;
+  }
+  base = matrix;
+  invalidate(changed);
+}
+
+void ZoomPyramid::clear() {
+  base = cv::Mat{};
+  levels.clear();
+  dirty.clear();
+}
+
+const cv::Mat &ZoomPyramid::level(int i) {
+  while (levels.size() <= i) {
+    const cv::Mat &src = levels.isEmpty() ? base : levels.last();
+    cv::Mat half;
+    cv::resize(src, half, cv::Size{(src.cols + 1) / 2, (src.rows + 1) / 2}, 0,
+               0, cv::INTER_AREA);
+    levels.push_back(half);
+  }
+  return levels[i];
+}
+
+// Rebuilds each dirty rectangle level by level from the one above, padded by
+// a pixel so the area filter doesn't leave a seam at its border.
+void ZoomPyramid::refresh() {
+  for (const auto &region : dirty) {
+    cv::Rect above = region;
+    for (auto i = 0; i < levels.size(); i++) {
+      const cv::Mat &src = i == 0 ? base : levels[i - 1];
+      cv::Mat &dst = levels[i];
+
+      cv::Rect rect{above.x / 2 - 1, above.y / 2 - 1, above.width / 2 + 3,
+                    above.height / 2 + 3};
+      rect &= cv::Rect{0, 0, dst.cols, dst.rows};
+      cv::Rect srcRect{rect.x * 2, rect.y * 2, rect.width * 2, rect.height * 2};
+      srcRect &= cv::Rect{0, 0, src.cols, src.rows};
+      if (rect.empty() || srcRect.empty()) {
+        break;
+      }
+
+      cv::Mat target = dst(rect);
+      cv::resize(src(srcRect), target, rect.size(), 0, 0, cv::INTER_AREA);
+      above = rect;
+    }
+  }
+  dirty.clear();
+}